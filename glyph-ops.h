@@ -0,0 +1,96 @@
+/*
+ * GLYPH OPS - The rune encoding table
+ *
+ * Every rune form in one place: glyph.h decodes from it, tools/glyphc.h
+ * measures and reads back what it emits with it and tools/glyph-dis.c
+ * prints with it. Include it anywhere; it only defines macros.
+ *
+ * GLYPH_RUNES(X)  X(rune, len, moded) for every byte that is a rune.
+ *   A moded rune picks its form by the byte after it; an unknown mode runs
+ *   as a NOP of the same length. Bytes not listed trap.
+ *
+ * GLYPH_FORMS(X)  X(rune, mode, OP, operands, text)
+ *   mode is 0 for runes without one. operands has a letter per byte left:
+ *     r  register, 7 bits        n  block name, the raw byte
+ *     l  literal byte            h  hex digit, its value
+ *   Operand i goes to GlyphOp slot a, b, c in turn, except that literals
+ *   and hex digits always go to c. text describes the form with A, B and
+ *   C standing for those slots.
+ */
+#ifndef GLYPH_OPS_H
+#define GLYPH_OPS_H
+
+#define GLYPH_RUNES(X) \
+	X('+', 4, 0) X('-', 4, 0) X('*', 4, 0) X('/', 4, 0) X('%', 4, 0) \
+	X('&', 4, 0) X('|', 4, 0) X('^', 4, 0) X('<', 4, 0) X('>', 4, 0) \
+	X('~', 3, 0) X('!', 5, 1) X('=', 5, 1) \
+	X(':', 4, 1) X('@', 4, 1) X('#', 4, 1) X('$', 5, 1) \
+	X('?', 3, 0) X('\'', 2, 0) X('.', 3, 1) \
+	X('{', 2, 0) X('}', 2, 0) X('[', 3, 1) X(']', 2, 0) \
+	X(';', 2, 0) X(',', 1, 0) X(0, 1, 0) \
+	X(' ', 1, 0) X('\t', 1, 0) X('\n', 1, 0) X('\v', 1, 0) X('\f', 1, 0) X('\r', 1, 0)
+
+#define GLYPH_FORMS(X) \
+	X('+',  0,    ADD,     "rrr", "A = B + C") \
+	X('-',  0,    SUB,     "rrr", "A = B - C") \
+	X('*',  0,    MUL,     "rrr", "A = B * C") \
+	X('/',  0,    DIV,     "rrr", "A = B / C") \
+	X('%',  0,    MOD,     "rrr", "A = B % C") \
+	X('&',  0,    AND,     "rrr", "A = B & C") \
+	X('|',  0,    OR,      "rrr", "A = B | C") \
+	X('^',  0,    XOR,     "rrr", "A = B ^ C") \
+	X('<',  0,    SHL,     "rrr", "A = B << C") \
+	X('>',  0,    SHR,     "rrr", "A = B >> C") \
+	X('~',  0,    NOT,     "rr",  "A = ~B") \
+	X('!',  '+',  ADDI,    "rrl", "A = B + C") \
+	X('!',  '-',  SUBI,    "rrl", "A = B - C") \
+	X('!',  '&',  ANDI,    "rrl", "A = B & C") \
+	X('!',  '<',  SHLI,    "rrl", "A = B << C") \
+	X('!',  '>',  SHRI,    "rrl", "A = B >> C") \
+	X('=',  '+',  ADDI,    "rrh", "A = B + C") \
+	X('=',  '-',  SUBI,    "rrh", "A = B - C") \
+	X('=',  '&',  ANDI,    "rrh", "A = B & C") \
+	X('=',  '<',  SHLI,    "rrh", "A = B << C") \
+	X('=',  '>',  SHRI,    "rrh", "A = B >> C") \
+	X(':',  '.',  COPY,    "rr",  "A = B") \
+	X(':',  '\'', LIT,     "rl",  "A = C") \
+	X(':',  '0',  LIT,     "rh",  "A = C") \
+	X('@',  '<',  LOAD,    "rr",  "A = mem[B]") \
+	X('@',  '>',  STORE,   "rr",  "mem[A] = B") \
+	X('@',  'h',  LOAD16,  "rr",  "A = mem16[B]") \
+	X('@',  'H',  STORE16, "rr",  "mem16[A] = B") \
+	X('@',  'w',  LOAD32,  "rr",  "A = mem32[B]") \
+	X('@',  'W',  STORE32, "rr",  "mem32[A] = B") \
+	X('$',  '.',  MOVE,    "rrr", "mem[A..] = mem[B..], C bytes") \
+	X('$',  '=',  FILL,    "rrr", "mem[A..] = B, C bytes") \
+	X('$',  '?',  MCMP,    "rrr", "? = compare mem[A..] with mem[B..], C bytes") \
+	X('#',  '<',  IN,      "rr",  "A = port[B]") \
+	X('#',  '>',  OUT,     "rr",  "port[A] = B") \
+	X('?',  0,    CMP,     "rr",  "? = compare A with B") \
+	X('\'', 0,    MARK,    "r",   "A = here") \
+	X('.',  '.',  JMP,     "r",   "leap to A") \
+	X('.',  '=',  JEQ,     "r",   "leap to A if equal") \
+	X('.',  '!',  JNE,     "r",   "leap to A if not equal") \
+	X('.',  '>',  JGT,     "r",   "leap to A if greater") \
+	X('.',  '<',  JLT,     "r",   "leap to A if less") \
+	X('{',  0,    FUNC,    "n",   "A = here, skip to }A") \
+	X('}',  0,    NOP,     "n",   "end of {A") \
+	X('[',  '=',  SEQ,     "n",   "skip to ]A if equal") \
+	X('[',  '!',  SNE,     "n",   "skip to ]A if not equal") \
+	X('[',  '>',  SGT,     "n",   "skip to ]A if greater") \
+	X('[',  '<',  SLT,     "n",   "skip to ]A if less") \
+	X(']',  0,    NOP,     "n",   "end of [A") \
+	X(';',  0,    CALL,    "r",   "call A") \
+	X(',',  0,    RET,     "",    "return") \
+	X(0,    0,    HALT,    "",    "halt") \
+	X(' ',  0,    NOP,     "",    "") \
+	X('\t', 0,    NOP,     "",    "") \
+	X('\n', 0,    NOP,     "",    "") \
+	X('\v', 0,    NOP,     "",    "") \
+	X('\f', 0,    NOP,     "",    "") \
+	X('\r', 0,    NOP,     "",    "")
+
+/* Value of a hex digit operand, as the VM reads it (no validation) */
+#define GLYPH_HEX(x) ((uint32_t)((x) <= '9' ? (x) - '0' : ((x) | 32) - 'a' + 10))
+
+#endif /* GLYPH_OPS_H */
@@ -0,0 +1,205 @@
+/*
+ * GLYPH SAMPLE - Sampling profiler for guest code
+ * Usage: #define GLYPH_SAMPLE_IMPL before including in ONE .c file
+ *        (alongside GLYPH_IMPL)
+ *
+ * Runs a VM in slices of about `every` steps and, between slices, records
+ * the guest PC and the return addresses on vm->stk as one call stack.
+ * Addresses are named after the nearest label at or below them, from a map
+ * in the `;   name = 0x0123` form the generators print. Identical stacks
+ * are counted once and written in the collapsed format flame graph tools
+ * read: `outer;inner;leaf count`. Deeper stacks keep their innermost
+ * GLYPH_SAMPLE_DEPTH frames.
+ */
+#ifndef GLYPH_SAMPLE_H
+#define GLYPH_SAMPLE_H
+
+#include "glyph.h"
+
+#define GLYPH_SAMPLE_EVERY 1000  /* default mean steps between samples */
+#define GLYPH_SAMPLE_DEPTH 256   /* return addresses kept per sample */
+
+typedef struct {
+	char name[32];
+	u32  addr;
+} GlyphSym;
+
+/* One distinct stack: frames pool[off .. off+len), root first */
+typedef struct {
+	u32 off, len;
+	u64 count;
+} GlyphStack;
+
+typedef struct {
+	GlyphSym   *syms;   /* sorted by address */
+	u32         nsyms;
+	u32        *pool;   /* frame ids: symbol index, or 1<<31 | address */
+	u32         used, room;
+	GlyphStack *table;  /* open addressing, len 0 = empty */
+	u32         stacks, cap;
+	u32         rng;    /* jitters slice lengths against loop aliasing */
+	u64         samples, dropped;
+	u64         truncated;  /* samples that lost their outer frames */
+} GlyphSampler;
+
+void glyph_sampler_init(GlyphSampler *s);
+void glyph_sampler_free(GlyphSampler *s);
+/* Read symbols from a label map; other lines are ignored. Returns the
+ * number of symbols, or -1 when out of memory. */
+int  glyph_sampler_labels(GlyphSampler *s, FILE *map);
+/* Record the VM's current call stack as one sample */
+void glyph_sample(GlyphSampler *s, const Glyph *vm);
+/* glyph_run with a sample roughly every `every` steps */
+GlyphStatus glyph_run_sampled(Glyph *vm, GlyphSampler *s, u64 every);
+/* Write every stack seen, one `frame;frame;... count` line each */
+void glyph_sampler_write(const GlyphSampler *s, FILE *out);
+
+/* ────────────────────────────────────────────────────────────────────────── */
+#ifdef GLYPH_SAMPLE_IMPL
+
+#include <stdlib.h>
+
+#define GLYPH_RAW (1u << 31)
+
+void glyph_sampler_init(GlyphSampler *s) {
+	memset(s, 0, sizeof(*s));
+	s->rng = 2463534242u;
+}
+
+void glyph_sampler_free(GlyphSampler *s) {
+	free(s->syms);
+	free(s->pool);
+	free(s->table);
+	glyph_sampler_init(s);
+}
+
+static int glyph_sym_cmp(const void *a, const void *b) {
+	u32 x = ((const GlyphSym *)a)->addr, y = ((const GlyphSym *)b)->addr;
+	return (x > y) - (x < y);
+}
+
+int glyph_sampler_labels(GlyphSampler *s, FILE *map) {
+	char line[256], name[32];
+	unsigned addr;
+	u32 room = s->nsyms;
+	while (fgets(line, sizeof(line), map)) {
+		if (sscanf(line, " ; %31s = %x", name, &addr) != 2) continue;
+		if (s->nsyms == room) {
+			room = room ? room * 2 : 256;
+			GlyphSym *syms = realloc(s->syms, room * sizeof(GlyphSym));
+			if (!syms) return -1;
+			s->syms = syms;
+		}
+		strcpy(s->syms[s->nsyms].name, name);
+		s->syms[s->nsyms++].addr = addr;
+	}
+	qsort(s->syms, s->nsyms, sizeof(GlyphSym), glyph_sym_cmp);
+	return s->nsyms;
+}
+
+/* Frame id of an address: the last symbol at or below it */
+static u32 glyph_sample_frame(const GlyphSampler *s, u32 addr) {
+	u32 lo = 0, hi = s->nsyms;
+	while (lo < hi) {
+		u32 mid = (lo + hi) / 2;
+		if (s->syms[mid].addr <= addr) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo ? lo - 1 : (GLYPH_RAW | addr);
+}
+
+static u32 glyph_stack_hash(const u32 *f, u32 n) {
+	u32 h = 2166136261u;
+	for (u32 i = 0; i < n; i++) h = (h ^ f[i]) * 16777619u;
+	return h;
+}
+
+static bool glyph_sampler_grow(GlyphSampler *s) {
+	u32 cap = s->cap ? s->cap * 2 : 1024;
+	GlyphStack *table = calloc(cap, sizeof(GlyphStack));
+	if (!table) return false;
+	for (u32 i = 0; i < s->cap; i++) {
+		GlyphStack *e = &s->table[i];
+		if (!e->len) continue;
+		u32 j = glyph_stack_hash(s->pool + e->off, e->len) & (cap - 1);
+		while (table[j].len) j = (j + 1) & (cap - 1);
+		table[j] = *e;
+	}
+	free(s->table);
+	s->table = table;
+	s->cap = cap;
+	return true;
+}
+
+void glyph_sample(GlyphSampler *s, const Glyph *vm) {
+	u32 f[GLYPH_SAMPLE_DEPTH + 1], n = 0, k = 0;
+	if (vm->sp > GLYPH_SAMPLE_DEPTH) {
+		k = vm->sp - GLYPH_SAMPLE_DEPTH;
+		s->truncated++;
+	}
+	/* Return addresses point past their ;a, so name the byte before.
+	 * Anything outside memory is a host sentinel, not a guest frame. */
+	for (; k < vm->sp; k++)
+		if (vm->stk[k] - 1 < vm->size) f[n++] = glyph_sample_frame(s, vm->stk[k] - 1);
+	f[n++] = glyph_sample_frame(s, vm->reg['.']);
+
+	if (2 * (s->stacks + 1) > s->cap && !glyph_sampler_grow(s)) { s->dropped++; return; }
+	u32 i = glyph_stack_hash(f, n) & (s->cap - 1);
+	for (;; i = (i + 1) & (s->cap - 1)) {
+		GlyphStack *e = &s->table[i];
+		if (!e->len) break;
+		if (e->len == n && !memcmp(s->pool + e->off, f, n * sizeof(u32))) {
+			e->count++;
+			s->samples++;
+			return;
+		}
+	}
+	if (s->room - s->used < n) {
+		u32 room = s->room ? s->room * 2 : 4096;
+		u32 *pool = realloc(s->pool, room * sizeof(u32));
+		if (!pool) { s->dropped++; return; }
+		s->pool = pool;
+		s->room = room;
+	}
+	memcpy(s->pool + s->used, f, n * sizeof(u32));
+	s->table[i] = (GlyphStack){ s->used, n, 1 };
+	s->used += n;
+	s->stacks++;
+	s->samples++;
+}
+
+GlyphStatus glyph_run_sampled(Glyph *vm, GlyphSampler *s, u64 every) {
+	GlyphStatus st;
+	if (!every) every = GLYPH_SAMPLE_EVERY;
+	for (;;) {
+		s->rng ^= s->rng << 13; s->rng ^= s->rng >> 17; s->rng ^= s->rng << 5;
+		u64 slice = every / 2 + s->rng % every + 1;  /* mean ~every */
+		if ((st = glyph_run_for(vm, slice)) != GLYPH_BUDGET) return st;
+		glyph_sample(s, vm);
+	}
+}
+
+/* Frame names may not hold the format's separators */
+static void glyph_sample_name(const GlyphSampler *s, u32 id, FILE *out) {
+	if (id & GLYPH_RAW) { fprintf(out, "0x%04x", id & ~GLYPH_RAW); return; }
+	for (const char *p = s->syms[id].name; *p; p++)
+		fputc(*p == ';' || isspace((u8)*p) ? '_' : *p, out);
+}
+
+void glyph_sampler_write(const GlyphSampler *s, FILE *out) {
+	for (u32 i = 0; i < s->cap; i++) {
+		const GlyphStack *e = &s->table[i];
+		if (!e->len) continue;
+		for (u32 k = 0; k < e->len; k++) {
+			if (k) fputc(';', out);
+			glyph_sample_name(s, s->pool[e->off + k], out);
+		}
+		fprintf(out, " %llu\n", (unsigned long long)e->count);
+	}
+}
+
+#undef GLYPH_RAW
+
+#endif /* GLYPH_SAMPLE_IMPL */
+
+#endif /* GLYPH_SAMPLE_H */
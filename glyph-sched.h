@@ -0,0 +1,201 @@
+/*
+ * GLYPH SCHED - Run many independent Glyph VMs on a pool of threads
+ * Usage: #define GLYPH_SCHED_IMPL before including in ONE .c file
+ *        (alongside GLYPH_IMPL), link with -pthread
+ *
+ * Every worker owns a run queue. It takes the VM at the head, runs it for
+ * one time slice with glyph_run_for, and re-queues it at the tail until it
+ * halts or traps. If the queue cannot grow, the worker keeps running the
+ * VM itself. An idle worker steals from the tail of another queue, and
+ * when every queue is empty it sleeps until a VM is queued where it could
+ * steal it, or the last VM finishes.
+ */
+#ifndef GLYPH_SCHED_H
+#define GLYPH_SCHED_H
+
+#include "glyph.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+typedef struct {
+	pthread_mutex_t lock;
+	Glyph **vms;       /* ring buffer */
+	u32 head, count, cap;
+} GlyphQueue;
+
+typedef struct GlyphSched GlyphSched;
+
+typedef struct {
+	GlyphSched *s;
+	int id;
+	u64 slices, steals;
+} GlyphWorker;
+
+struct GlyphSched {
+	GlyphQueue  *queue;
+	GlyphWorker *worker;
+	int nthreads;
+	u64 slice;         /* steps per time slice */
+	atomic_uint live;  /* VMs not yet halted or trapped */
+	u32 next;          /* round-robin cursor for glyph_sched_add */
+	pthread_mutex_t idle_lock;
+	pthread_cond_t  idle;  /* idle workers wait here ... */
+	atomic_uint queued;    /* ... for this to move on */
+	atomic_uint sleepers;
+};
+
+/* Returns -1 for fewer than one thread, a zero slice, or out of memory */
+int  glyph_sched_init(GlyphSched *s, int nthreads, u64 slice);
+void glyph_sched_free(GlyphSched *s);
+/* Queue a VM; its memory, registers and callbacks stay owned by the caller.
+ * Callbacks run on worker threads. */
+int  glyph_sched_add(GlyphSched *s, Glyph *vm);
+/* Run every queued VM to completion, then return */
+void glyph_sched_run(GlyphSched *s);
+
+/* ────────────────────────────────────────────────────────────────────────── */
+#ifdef GLYPH_SCHED_IMPL
+
+#include <stdlib.h>
+
+/* Returns the VMs now queued, or -1 if the queue cannot grow */
+static int glyph_queue_push(GlyphQueue *q, Glyph *vm) {
+	pthread_mutex_lock(&q->lock);
+	if (q->count == q->cap) {
+		u32 cap = q->cap ? q->cap * 2 : 64;
+		Glyph **vms = malloc(cap * sizeof(Glyph *));
+		if (!vms) { pthread_mutex_unlock(&q->lock); return -1; }
+		for (u32 i = 0; i < q->count; i++)
+			vms[i] = q->vms[(q->head + i) % q->cap];
+		free(q->vms);
+		q->vms = vms; q->head = 0; q->cap = cap;
+	}
+	q->vms[(q->head + q->count) % q->cap] = vm;
+	int n = ++q->count;
+	pthread_mutex_unlock(&q->lock);
+	return n;
+}
+
+/* Work may be there to steal: wake one sleeper, or all when done */
+static void glyph_sched_wake(GlyphSched *s, bool all) {
+	atomic_fetch_add(&s->queued, 1);
+	if (!atomic_load(&s->sleepers)) return;
+	pthread_mutex_lock(&s->idle_lock);
+	if (all) pthread_cond_broadcast(&s->idle);
+	else pthread_cond_signal(&s->idle);
+	pthread_mutex_unlock(&s->idle_lock);
+}
+
+/* Owner takes from the head, thieves from the tail */
+static Glyph *glyph_queue_take(GlyphQueue *q, bool tail) {
+	Glyph *vm = NULL;
+	pthread_mutex_lock(&q->lock);
+	if (q->count) {
+		if (tail) {
+			vm = q->vms[(q->head + q->count - 1) % q->cap];
+		} else {
+			vm = q->vms[q->head];
+			q->head = (q->head + 1) % q->cap;
+		}
+		q->count--;
+	}
+	pthread_mutex_unlock(&q->lock);
+	return vm;
+}
+
+static void *glyph_worker(void *arg) {
+	GlyphWorker *w = arg;
+	GlyphSched *s = w->s;
+	for (;;) {
+		u32 seen = atomic_load(&s->queued);
+		Glyph *vm = glyph_queue_take(&s->queue[w->id], false);
+		for (int i = 1; !vm && i < s->nthreads; i++) {
+			vm = glyph_queue_take(&s->queue[(w->id + i) % s->nthreads], true);
+			if (vm) w->steals++;
+		}
+		if (!vm) {
+			/* Sleep unless a VM was queued or the last one ended since the
+			 * scan; a waker that missed sleepers bumped queued first */
+			pthread_mutex_lock(&s->idle_lock);
+			atomic_fetch_add(&s->sleepers, 1);
+			while (atomic_load(&s->live) && atomic_load(&s->queued) == seen)
+				pthread_cond_wait(&s->idle, &s->idle_lock);
+			atomic_fetch_sub(&s->sleepers, 1);
+			pthread_mutex_unlock(&s->idle_lock);
+			if (atomic_load(&s->live) == 0) break;
+			continue;
+		}
+		/* A VM the queue has no room for keeps running here */
+		GlyphStatus st;
+		int n;
+		do {
+			w->slices++;
+			st = glyph_run_for(vm, s->slice);
+		} while (st == GLYPH_BUDGET && (n = glyph_queue_push(&s->queue[w->id], vm)) < 0);
+		/* The owner takes the head next; anything behind it can be stolen */
+		if (st == GLYPH_BUDGET && n > 1) glyph_sched_wake(s, false);
+		if (st != GLYPH_BUDGET && atomic_fetch_sub(&s->live, 1) == 1)
+			glyph_sched_wake(s, true);
+	}
+	return NULL;
+}
+
+int glyph_sched_init(GlyphSched *s, int nthreads, u64 slice) {
+	memset(s, 0, sizeof(*s));
+	if (nthreads < 1 || !slice) return -1;
+	s->queue = calloc(nthreads, sizeof(GlyphQueue));
+	s->worker = calloc(nthreads, sizeof(GlyphWorker));
+	if (!s->queue || !s->worker) {
+		free(s->queue); free(s->worker);
+		return -1;
+	}
+	s->nthreads = nthreads;
+	s->slice = slice;
+	atomic_init(&s->live, 0);
+	atomic_init(&s->queued, 0);
+	atomic_init(&s->sleepers, 0);
+	pthread_mutex_init(&s->idle_lock, NULL);
+	pthread_cond_init(&s->idle, NULL);
+	for (int i = 0; i < nthreads; i++) {
+		pthread_mutex_init(&s->queue[i].lock, NULL);
+		s->worker[i].s = s;
+		s->worker[i].id = i;
+	}
+	return 0;
+}
+
+void glyph_sched_free(GlyphSched *s) {
+	for (int i = 0; i < s->nthreads; i++) {
+		pthread_mutex_destroy(&s->queue[i].lock);
+		free(s->queue[i].vms);
+	}
+	if (s->nthreads) {
+		pthread_mutex_destroy(&s->idle_lock);
+		pthread_cond_destroy(&s->idle);
+	}
+	free(s->queue);
+	free(s->worker);
+}
+
+int glyph_sched_add(GlyphSched *s, Glyph *vm) {
+	if (glyph_queue_push(&s->queue[s->next], vm) < 0) return -1;
+	s->next = (s->next + 1) % s->nthreads;
+	atomic_fetch_add(&s->live, 1);
+	glyph_sched_wake(s, false);
+	return 0;
+}
+
+void glyph_sched_run(GlyphSched *s) {
+	pthread_t *t = malloc(s->nthreads * sizeof(pthread_t));
+	int started = 0;
+	for (int i = 1; t && i < s->nthreads; i++, started++)
+		if (pthread_create(&t[i], NULL, glyph_worker, &s->worker[i])) break;
+	glyph_worker(&s->worker[0]);  /* the caller is worker 0 */
+	for (int i = 1; i <= started; i++)
+		pthread_join(t[i], NULL);
+	free(t);
+}
+
+#endif /* GLYPH_SCHED_IMPL */
+
+#endif /* GLYPH_SCHED_H */
@@ -1,5 +1,9 @@
 /*
- * GLYPH - Single-header character-based VM (~100 lines)
+ * GLYPH - Single-header character-based VM
+ * A byte-at-a-time interpreter, plus an optional decode cache with threaded
+ * dispatch and superinstructions, step budgets, snapshots with dirty page
+ * tracking, a configurable call stack, and build-time extras: an x86-64
+ * JIT (-DGLYPH_JIT) and an execution profiler (-DGLYPH_PROFILE).
  * Usage: #define GLYPH_IMPL before including in ONE .c file
  */
 #ifndef GLYPH_H
@@ -10,166 +14,1443 @@
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include "glyph-ops.h"
 
 typedef uint8_t  u8;
 typedef uint32_t u32;
+typedef uint64_t u64;
 
-/* Resonance */
-typedef void (*GlyphRes)(u8 port);
+typedef struct Glyph Glyph;
+typedef struct GlyphSnap GlyphSnap;
+typedef struct GlyphJit GlyphJit;
+typedef struct GlyphProfile GlyphProfile;
 
+/* Resonance: called with the VM, its user pointer and the port touched */
+typedef void (*GlyphRes)(Glyph *vm, void *user, u8 port);
+
+/* Decoded instruction: one slot per byte address, filled on first execution.
+ * a/b are register indices, c is a register index or a converted literal. */
 typedef struct {
+	u8  op, len, a, b;
+	u32 c;
+} GlyphOp;
+
+#define GLYPH_STACK 256  /* return addresses a VM holds without glyph_stack */
+
+struct Glyph {
 	u8 *mem;
-	u8  sp;
 	u32 size;
 	u32 reg[128];
-	u32 stk[256];
+	u32 *stk;       /* return addresses: stk0, or the caller's via glyph_stack */
+	u32 sp, depth;  /* frames in use, and room for */
+	u32 stk0[GLYPH_STACK];
 	u32 port[256];
 	GlyphRes emit, sense;
+	void *user;  /* host context handed to emit/sense */
+	GlyphOp *code;
+	u32 fused[8];  /* regions of code (1 << fuse_shift bytes) holding ... */
+	u8  fuse_shift; /* ... superinstructions, see glyph_fuse */
+	GlyphJit *jit;          /* native code tier, see glyph_jit_init */
+	GlyphProfile *prof;     /* execution counters, see glyph_profile_init */
+	u32 *dirty;             /* one bit per GLYPH_PAGE written since ... */
+	const GlyphSnap *base;  /* ... mem last matched this snapshot ... */
+	u32 base_gen;           /* ... as of this retake of it */
+	u8  gen;   /* skip-target cache generation */
+	u8  trap;  /* why the VM stopped abnormally (GLYPH_TRAP_*) */
+	u64 steps; /* instructions retired so far */
 	bool halt;
-} Glyph;
+};
+
+/* Saved machine: every register, the stack, ports and a copy of memory.
+ * mem is supplied by the caller and holds vm->size bytes. A VM with a stack
+ * from glyph_stack also needs stk, with room for its depth; without it only
+ * GLYPH_STACK frames fit. */
+struct GlyphSnap {
+	Glyph vm;
+	u8 *mem;
+	u32 *stk;
+	u32 gen;  /* times taken, so VMs based on an older take resync */
+};
+
+/* Dirty tracking granularity, and the u32 words of bitmap a VM needs */
+#define GLYPH_PAGE 256
+#define GLYPH_DIRTY_WORDS(size) (((size) + GLYPH_PAGE * 32 - 1) / (GLYPH_PAGE * 32))
+
+/* glyph_run_for outcome */
+typedef enum { GLYPH_HALTED, GLYPH_BUDGET, GLYPH_TRAPPED } GlyphStatus;
+/* Stack traps leave PC on the ; or , so the host can grow the stack and
+ * resume */
+enum { GLYPH_TRAP_NONE, GLYPH_TRAP_RUNE, GLYPH_TRAP_OVERFLOW, GLYPH_TRAP_UNDERFLOW };
 
 void glyph_init(Glyph *vm, u8 *mem, u32 size);
 void glyph_run(Glyph *vm);
 
+/* Return stack of depth frames in stk, from the heap, an arena or anything
+ * that outlives the VM; NULL goes back to the GLYPH_STACK built in. Frames
+ * in use move over. Returns -1 if they do not fit. */
+int  glyph_stack(Glyph *vm, u32 *stk, u32 depth);
+
+/* Run at most max_steps instructions. A budget stop leaves the VM between
+ * two instructions, so the next call resumes exactly where this one ended. */
+GlyphStatus glyph_run_for(Glyph *vm, u64 max_steps);
+
+/* Attach a decode cache of vm->size slots; glyph_run then executes from it.
+ * Hosts that write mem behind the VM's back must glyph_touch the bytes. */
+void glyph_predecode(Glyph *vm, GlyphOp *code);
+void glyph_touch(Glyph *vm, u32 addr, u32 len);
+
+/* Record which pages the VM writes, in GLYPH_DIRTY_WORDS(vm->size) words.
+ * Snapshots and restores then copy only pages changed since the last one. */
+void glyph_track(Glyph *vm, u32 *dirty);
+/* Save the whole machine into snap; snap->mem must be set, and snap->stk
+ * too when more than GLYPH_STACK frames are in use. Retaking a snapshot
+ * only copies dirty pages, and stales other VMs restored from it. Returns
+ * -1 if the stack does not fit. */
+int  glyph_snapshot(Glyph *vm, GlyphSnap *snap);
+/* Roll vm back to snap, keeping its mem, code, stack, callbacks and user
+ * pointer. Returns -1 if the sizes differ or the frames do not fit. */
+int  glyph_restore(Glyph *vm, const GlyphSnap *snap);
+
+#ifdef GLYPH_JIT
+/* Native tier for x86-64 Linux. Backward leap and call targets that get hot
+ * have their straight run of ALU/COPY/LIT/CMP/MARK/LOAD runes compiled to
+ * machine code; everything else stays in the decoded interpreter. Writes to
+ * compiled bytes flush the whole tier. Needs glyph_predecode first. */
+#define GLYPH_JIT_HOT  16   /* leaps to a target before it is compiled */
+#define GLYPH_JIT_MAX  64   /* runes per compiled block */
+#define GLYPH_JIT_COLD 255  /* heat of a target too short to compile */
+
+struct GlyphJit {
+	u8  *buf;     /* executable blocks */
+	u32  cap, used;
+	u32 *entry;   /* per address: block offset + 1, or 0 */
+	u8  *heat;    /* per address: leaps seen, up to hot, or GLYPH_JIT_COLD */
+	u32 *pages;   /* GLYPH_PAGE pages holding compiled runes */
+	u8   hot;     /* below GLYPH_JIT_COLD */
+	u64  blocks, flushes;
+};
+
+/* Reserve cap bytes (at least 64K) of code space. Returns -1 off x86-64
+ * Linux, without a decode cache, or when out of memory. */
+int  glyph_jit_init(Glyph *vm, GlyphJit *jit, u32 cap);
+void glyph_jit_free(Glyph *vm, GlyphJit *jit);
+#endif
+
+#ifdef GLYPH_PROFILE
+/* Counters kept while a profile is attached; the hot path only increments.
+ * Profiling builds turn off superinstructions and the JIT, so every rune is
+ * counted at its own address by both engines. */
+struct GlyphProfile {
+	u64  op[256];            /* runes executed, by rune byte */
+	u64 *pc;                 /* per address: runes executed there */
+	u64 *call;               /* per address: ; calls landing there */
+	u64  in[256], out[256];  /* port reads and writes */
+	u64  skips;              /* {/[ skips taken */
+	u64  scans, scanned;     /* searches for an end marker, bytes searched */
+	u64  scan_len[33];       /* searches of 0, 1, 2-3, 4-7 ... bytes */
+};
+
+/* Allocate per-address counters for vm->size bytes and attach. Returns -1
+ * when out of memory. */
+int  glyph_profile_init(Glyph *vm, GlyphProfile *prof);
+void glyph_profile_free(Glyph *vm, GlyphProfile *prof);
+/* Human-readable summary, top entries only */
+void glyph_profile_report(Glyph *vm, FILE *out);
+/* Every nonzero counter as one JSON object */
+void glyph_profile_json(Glyph *vm, FILE *out);
+#endif
+
 /* ────────────────────────────────────────────────────────────────────────── */
 #ifdef GLYPH_IMPL
 
+#if defined(GLYPH_JIT) || defined(GLYPH_PROFILE)
+#include <stdlib.h>
+#endif
+#ifdef GLYPH_JIT
+#if defined(__x86_64__) && defined(__linux__) && !defined(GLYPH_PROFILE)
+#define GLYPH_JIT_X64
+#include <sys/mman.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS 0x20  /* hidden by strict -std=c11 */
+#endif
+#endif
+#endif
+
 #define R(x) vm->reg[(x) & 127]
 #define M(x) vm->mem[(x) & (vm->size - 1)]
 #define PC   R('.')
 
+/* Profile counters: PROF(out[p]++) bumps vm->prof->out[p] if attached */
+#ifdef GLYPH_PROFILE
+#define PROF(x) do { if (vm->prof) vm->prof->x; } while (0)
+#else
+#define PROF(x) ((void)0)
+#endif
+
+static inline void glyph_prof_rune(Glyph *vm, u32 pc) {
+#ifdef GLYPH_PROFILE
+	if (!vm->prof || pc >= vm->size) return;
+	vm->prof->pc[pc]++;
+	vm->prof->op[vm->mem[pc]]++;
+#else
+	(void)vm; (void)pc;
+#endif
+}
+
+static inline void glyph_prof_scan(Glyph *vm, u32 len) {
+#ifdef GLYPH_PROFILE
+	if (!vm->prof) return;
+	int k = 0;
+	while (len >> k) k++;
+	vm->prof->scans++;
+	vm->prof->scanned += len;
+	vm->prof->scan_len[k]++;
+#else
+	(void)vm; (void)len;
+#endif
+}
+
 static inline u8 N(Glyph *vm) {
 	return (PC < vm->size) ? vm->mem[PC++] : (vm->halt = 1, 0);
 }
 
-void glyph_run(Glyph *vm) {
-	u8 op, a, b, c;
-	while (!vm->halt) {
-		op = N(vm);
-		if (vm->halt) break;
-		#ifdef DEBUG
-		printf("OP: %c(%d) PC: %u\n", op, op, PC - 1);
-		#endif
-		switch (op) {
-		/* Arithmetic: +abc -abc *abc /abc %abc */
-		case '+': a=N(vm); b=N(vm); c=N(vm); R(a) = R(b) + R(c); break;
-		case '-': a=N(vm); b=N(vm); c=N(vm); R(a) = R(b) - R(c); break;
-		case '*': a=N(vm); b=N(vm); c=N(vm); R(a) = R(b) * R(c); break;
-		case '/': a=N(vm); b=N(vm); c=N(vm); R(a) = R(c) ? R(b)/R(c) : 0; break;
-		case '%': a=N(vm); b=N(vm); c=N(vm); R(a) = R(c) ? R(b)%R(c) : 0; break;
-
-		/* Bitwise: &abc |abc ^abc ~ab <abc >abc */
-		case '&': a=N(vm); b=N(vm); c=N(vm); R(a) = R(b) & R(c); break;
-		case '|': a=N(vm); b=N(vm); c=N(vm); R(a) = R(b) | R(c); break;
-		case '^': a=N(vm); b=N(vm); c=N(vm); R(a) = R(b) ^ R(c); break;
-		case '~': a=N(vm); b=N(vm); R(a) = ~R(b); break;
-		case '<': a=N(vm); b=N(vm); c=N(vm); R(a) = R(b) << R(c); break;
-		case '>': a=N(vm); b=N(vm); c=N(vm); R(a) = R(b) >> R(c); break;
-
-		/* Load: :.ab :'ab :0ab */
-		case ':':
-			a = N(vm); b = N(vm); c = N(vm);
-			if      (a == '.') R(b) = R(c);
-			else if (a == '\'') R(b) = c;
-			else if (a == '0') R(b) = (c <= '9') ? c - '0' : (c | 32) - 'a' + 10;
-			break;
+/* Decode cache upkeep. A rune's slot covers up to 5 bytes, so a write at
+ * addr stales slots addr-4..addr. A fused slot covers up to GLYPH_FUSE_MAX,
+ * so in regions that hold one the slots further back are checked too.
+ * Cached {/[ targets only move when a }x/]x pair appears or disappears;
+ * those writes bump the generation instead. */
+#define GLYPH_FUSE_MAX 48
 
-		/* Memory: @<ab @>ab */
-		case '@':
-			a = N(vm); b = N(vm); c = N(vm);
-			if      (a == '<') R(b) = M(R(c));
-			else if (a == '>') M(R(b)) = R(c);
-			break;
+static inline bool glyph_fused_at(Glyph *vm, u32 addr) {
+	u32 r = addr >> vm->fuse_shift;
+	return vm->fused[r / 32] >> (r % 32) & 1;
+}
 
-		/* Ports: #<ab #>ab (resonance) */
-		case '#':
-			a=N(vm); b=N(vm); c=N(vm);
-			if (a == '<') {
-				u8 p = R(c) & 255;
-				if (vm->sense) vm->sense(p);
-				R(b) = vm->port[p];
-			} else if (a == '>') {
-				u8 p = R(b) & 255;
-				vm->port[p] = R(c);
-				if (vm->emit) vm->emit(p);
-			}
-			break;
+#ifdef GLYPH_JIT_X64
+static void glyph_jit_forget(Glyph *vm, u32 lo, u32 hi);
+#endif
 
-		/* Compare: ?ab sets r['?'] = flags(a,b) [bit0=eq, bit1=gt, bit2=lt] */
-		case '?': {
-			a = N(vm); b = N(vm);
-			u32 va = R(a), vb = R(b);
-			R('?') = (va == vb ? 1 : 0) | (va > vb ? 2 : 0) | (va < vb ? 4 : 0);
-			break;
+static void glyph_forget(Glyph *vm, u32 addr, u32 len) {
+	u32 lo = addr > 4 ? addr - 4 : 0;
+	u32 hi = (len > vm->size - addr) ? vm->size : addr + len;
+	memset(vm->code + lo, 0, (hi - lo) * sizeof(GlyphOp));
+	u32 far = addr > GLYPH_FUSE_MAX ? addr - GLYPH_FUSE_MAX : 0;
+	if (lo > far && (glyph_fused_at(vm, far) || glyph_fused_at(vm, lo)))
+		for (u32 p = far; p < lo; p++)
+			if (vm->code[p].len > addr - p)
+				memset(vm->code + p, 0, sizeof(GlyphOp));
+#ifdef GLYPH_JIT_X64
+	if (vm->jit) glyph_jit_forget(vm, lo, hi);
+#endif
+}
+
+/* Drop every decoded slot */
+static void glyph_clear(Glyph *vm) {
+	memset(vm->code, 0, vm->size * sizeof(GlyphOp));
+	memset(vm->fused, 0, sizeof(vm->fused));
+}
+
+static void glyph_reskip(Glyph *vm) {
+	if (++vm->gen == 0) glyph_clear(vm);
+}
+
+static inline void glyph_dirty(Glyph *vm, u32 addr) {
+	u32 page = addr / GLYPH_PAGE;
+	vm->dirty[page / 32] |= 1u << (page % 32);
+}
+
+#define IS_END(x) ((x) == '}' || (x) == ']')
+
+static inline void glyph_poke(Glyph *vm, u32 addr, u8 v) {
+	u8 old = vm->mem[addr];
+	if (old == v) return;
+	vm->mem[addr] = v;
+	if (vm->dirty) glyph_dirty(vm, addr);
+	if (!vm->code) return;
+	glyph_forget(vm, addr, 1);
+	if (IS_END(old) || IS_END(v) || (addr && IS_END(vm->mem[addr - 1])))
+		glyph_reskip(vm);
+}
+
+/* n-byte little-endian value at x; every byte's address goes through M() */
+static inline u32 glyph_load(Glyph *vm, u32 x, int n) {
+	u32 v = 0;
+	x &= vm->size - 1;
+	if (x + n <= vm->size) {
+		for (int i = n; i--;) v = v << 8 | vm->mem[x + i];
+		return v;
+	}
+	for (int i = n; i--;) v = v << 8 | M(x + i);
+	return v;
+}
+
+static inline void glyph_store(Glyph *vm, u32 x, u32 v, int n) {
+	for (int i = 0; i < n; i++, v >>= 8)
+		glyph_poke(vm, (x + i) & (vm->size - 1), v);
+}
+
+/* Dirty pages and stale slots for mem[addr, addr+len), addr < vm->size */
+static void glyph_wrote(Glyph *vm, u32 addr, u32 len) {
+	if (vm->dirty) {
+		u32 end = (len > vm->size - addr) ? vm->size : addr + len;
+		for (u32 a = addr; a < end; a = (a | (GLYPH_PAGE - 1)) + 1)
+			glyph_dirty(vm, a);
+	}
+	if (vm->code) glyph_forget(vm, addr, len);
+}
+
+/* ──────────────────────────────────────────────────────────────────────────
+ * Bulk memory: $. $= $? run as memmove/memset/memcmp over ranges that wrap
+ * at the end of memory, each address going through the mask as M() does.
+ * Counts above vm->size are cut to vm->size. One rune is one step.
+ * ────────────────────────────────────────────────────────────────────────── */
+
+/* Bytes from addr to the end of memory, at most n */
+static inline u32 glyph_run_len(Glyph *vm, u32 addr, u32 n) {
+	return vm->size - addr < n ? vm->size - addr : n;
+}
+
+/* Does mem[addr, addr+n) hold a }x or ]x end marker */
+static bool glyph_ends_in(Glyph *vm, u32 addr, u32 n) {
+	while (n) {
+		u32 k = glyph_run_len(vm, addr, n);
+		if (memchr(vm->mem + addr, '}', k) || memchr(vm->mem + addr, ']', k))
+			return true;
+		n -= k; addr = 0;
+	}
+	return false;
+}
+
+/* mem[addr, addr+n) was rewritten; ends says whether it held a marker */
+static void glyph_wrote_ring(Glyph *vm, u32 addr, u32 n, bool ends) {
+	u32 k = glyph_run_len(vm, addr, n);
+	glyph_wrote(vm, addr, k);
+	if (n > k) glyph_wrote(vm, 0, n - k);
+	if (vm->code && (ends || glyph_ends_in(vm, addr, n) ||
+	                 (addr && IS_END(vm->mem[addr - 1]))))
+		glyph_reskip(vm);
+}
+
+/* A copy to off bytes past its source whose ranges overlap at both ends:
+ * no direction is safe. Bytes move along the cycles p, p+off, p+2*off...
+ * (one per residue of gcd(off, size)). On a cycle holding a byte the copy
+ * leaves alone each chain moves up from such a byte; a cycle lying wholly
+ * inside both ranges just turns. */
+static void glyph_move_ring(Glyph *vm, u32 d, u32 n, u32 off) {
+	u32 mask = vm->size - 1, s = (d - off) & mask, g = off & -off, p;
+	u8 carry, old;
+	for (u32 c = 0; c < g; c++) {
+		if (((c - d - n) & (g - 1)) < vm->size - n) continue;
+		p = c; carry = vm->mem[c];
+		do {
+			p = (p + off) & mask;
+			old = vm->mem[p]; vm->mem[p] = carry; carry = old;
+		} while (p != c);
+	}
+	for (u32 t = n; t < vm->size; t++) {
+		p = (d + t) & mask; carry = vm->mem[p];
+		for (;;) {
+			p = (p + off) & mask;
+			old = vm->mem[p]; vm->mem[p] = carry; carry = old;
+			if (((p - s) & mask) >= n) break;  /* not a source byte */
 		}
+	}
+}
 
-		/* Label: 'a sets r[a] = PC (for backward jumps) */
-		case '\'': a = N(vm); R(a) = PC; break;
-
-		/* Block end markers: }a and ]a are 2-byte NOPs */
-		case '}': case ']': N(vm); break;
-
-		/* Jump backward: ..a .=a .!a .>a .<a (to r[a]) */
-		case '.': {
-			a = N(vm); b = N(vm);
-			int cond = (a == '.') ||
-			           (a == '=' && (R('?') & 1)) ||
-			           (a == '!' && !(R('?') & 1)) ||
-			           (a == '>' && (R('?') & 2)) ||
-			           (a == '<' && (R('?') & 4));
-			if (cond) PC = R(b);
-			break;
+/* mem[d..] = mem[s..] for n bytes, as if all were read before any write */
+static void glyph_move(Glyph *vm, u32 d, u32 s, u32 n) {
+	u32 mask = vm->size - 1, off, i, k;
+	d &= mask; s &= mask;
+	if (n > vm->size) n = vm->size;
+	off = (d - s) & mask;
+	if (!n || !off) return;
+	bool ends = vm->code && glyph_ends_in(vm, d, n);
+	if (off < n && vm->size - off < n) {
+		glyph_move_ring(vm, d, n, off);
+	} else if (off >= n) {            /* front to back */
+		for (i = 0; i < n; i += k) {
+			u32 to = (d + i) & mask, from = (s + i) & mask;
+			k = glyph_run_len(vm, to, glyph_run_len(vm, from, n - i));
+			memmove(vm->mem + to, vm->mem + from, k);
+		}
+	} else {                          /* back to front */
+		for (i = n; i; i -= k) {
+			u32 to = (d + i - 1) & mask, from = (s + i - 1) & mask;
+			k = i;
+			if (k > to + 1) k = to + 1;
+			if (k > from + 1) k = from + 1;
+			memmove(vm->mem + to + 1 - k, vm->mem + from + 1 - k, k);
+		}
+	}
+	glyph_wrote_ring(vm, d, n, ends);
+}
+
+/* mem[d..] = v for n bytes */
+static void glyph_fill(Glyph *vm, u32 d, u8 v, u32 n) {
+	d &= vm->size - 1;
+	if (n > vm->size) n = vm->size;
+	if (!n) return;
+	bool ends = vm->code && glyph_ends_in(vm, d, n);
+	u32 k = glyph_run_len(vm, d, n);
+	memset(vm->mem + d, v, k);
+	memset(vm->mem, v, n - k);
+	glyph_wrote_ring(vm, d, n, ends);
+}
+
+/* Flags of mem[a..] against mem[b..] over n bytes, as ? sets them */
+static u32 glyph_mcmp(Glyph *vm, u32 a, u32 b, u32 n) {
+	u32 mask = vm->size - 1;
+	int r = 0;
+	a &= mask; b &= mask;
+	if (n > vm->size) n = vm->size;
+	while (n && !r) {
+		u32 k = glyph_run_len(vm, a, glyph_run_len(vm, b, n));
+		r = memcmp(vm->mem + a, vm->mem + b, k);
+		a = (a + k) & mask; b = (b + k) & mask; n -= k;
+	}
+	return r == 0 ? 1 : r > 0 ? 2 : 4;
+}
+
+#undef IS_END
+
+/* Reference engine: fetch and execute one instruction straight from mem */
+static inline void glyph_step(Glyph *vm) {
+	u8 op, a, b, c, d;
+	u32 x, at = PC;
+	op = N(vm);
+	if (vm->halt) return;
+	#ifdef DEBUG
+	printf("OP: %c(%d) PC: %u\n", op, op, PC - 1);
+	#endif
+	switch (op) {
+	/* Arithmetic: +abc -abc *abc /abc %abc */
+	case '+': a=N(vm); b=N(vm); c=N(vm); R(a) = R(b) + R(c); break;
+	case '-': a=N(vm); b=N(vm); c=N(vm); R(a) = R(b) - R(c); break;
+	case '*': a=N(vm); b=N(vm); c=N(vm); R(a) = R(b) * R(c); break;
+	case '/': a=N(vm); b=N(vm); c=N(vm); R(a) = R(c) ? R(b)/R(c) : 0; break;
+	case '%': a=N(vm); b=N(vm); c=N(vm); R(a) = R(c) ? R(b)%R(c) : 0; break;
+
+	/* Bitwise: &abc |abc ^abc ~ab <abc >abc */
+	case '&': a=N(vm); b=N(vm); c=N(vm); R(a) = R(b) & R(c); break;
+	case '|': a=N(vm); b=N(vm); c=N(vm); R(a) = R(b) | R(c); break;
+	case '^': a=N(vm); b=N(vm); c=N(vm); R(a) = R(b) ^ R(c); break;
+	case '~': a=N(vm); b=N(vm); R(a) = ~R(b); break;
+	case '<': a=N(vm); b=N(vm); c=N(vm); R(a) = R(b) << (R(c) & 31); break;
+	case '>': a=N(vm); b=N(vm); c=N(vm); R(a) = R(b) >> (R(c) & 31); break;
+
+	/* Immediates: !+abX !-abX !&abX !<abX !>abX, or = with a hex digit */
+	case '!':
+	case '=':
+		d = N(vm); a = N(vm); b = N(vm); c = N(vm);
+		x = op == '=' ? GLYPH_HEX(c) : c;
+		if      (d == '+') R(a) = R(b) + x;
+		else if (d == '-') R(a) = R(b) - x;
+		else if (d == '&') R(a) = R(b) & x;
+		else if (d == '<') R(a) = R(b) << (x & 31);
+		else if (d == '>') R(a) = R(b) >> (x & 31);
+		break;
+
+	/* Load: :.ab :'ab :0ab */
+	case ':':
+		a = N(vm); b = N(vm); c = N(vm);
+		if      (a == '.') R(b) = R(c);
+		else if (a == '\'') R(b) = c;
+		else if (a == '0') R(b) = (c <= '9') ? c - '0' : (c | 32) - 'a' + 10;
+		break;
+
+	/* Memory: @<ab @>ab, 16 bits @hab @Hab, 32 bits @wab @Wab */
+	case '@':
+		a = N(vm); b = N(vm); c = N(vm);
+		if      (a == '<') R(b) = M(R(c));
+		else if (a == '>') glyph_poke(vm, R(b) & (vm->size - 1), R(c));
+		else if (a == 'h') R(b) = glyph_load(vm, R(c), 2);
+		else if (a == 'H') glyph_store(vm, R(b), R(c), 2);
+		else if (a == 'w') R(b) = glyph_load(vm, R(c), 4);
+		else if (a == 'W') glyph_store(vm, R(b), R(c), 4);
+		break;
+
+	/* Bulk memory: $.abc $=abc $?abc over R(c) bytes */
+	case '$':
+		a = N(vm); b = N(vm); c = N(vm); d = N(vm);
+		if      (a == '.') glyph_move(vm, R(b), R(c), R(d));
+		else if (a == '=') glyph_fill(vm, R(b), R(c), R(d));
+		else if (a == '?') R('?') = glyph_mcmp(vm, R(b), R(c), R(d));
+		break;
+
+	/* Ports: #<ab #>ab (resonance) */
+	case '#':
+		a=N(vm); b=N(vm); c=N(vm);
+		if (a == '<') {
+			u8 p = R(c) & 255;
+			PROF(in[p]++);
+			if (vm->sense) vm->sense(vm, vm->user, p);
+			R(b) = vm->port[p];
+		} else if (a == '>') {
+			u8 p = R(b) & 255;
+			PROF(out[p]++);
+			vm->port[p] = R(c);
+			if (vm->emit) vm->emit(vm, vm->user, p);
 		}
+		break;
+
+	/* Compare: ?ab sets r['?'] = flags(a,b) [bit0=eq, bit1=gt, bit2=lt] */
+	case '?': {
+		a = N(vm); b = N(vm);
+		u32 va = R(a), vb = R(b);
+		R('?') = (va == vb ? 1 : 0) | (va > vb ? 2 : 0) | (va < vb ? 4 : 0);
+		break;
+	}
+
+	/* Label: 'a sets r[a] = PC (for backward jumps) */
+	case '\'': a = N(vm); R(a) = PC; break;
 
-		/* Skip forward: {a (sets r[a]=PC, skips to }a), [=a [!a [>a [<a (conditional to ]a) */
-		case '{': {
-			b = N(vm);
-			R(b) = PC;  /* record function entry point */
-			u32 scan = PC;
+	/* Block end markers: }a and ]a are 2-byte NOPs */
+	case '}': case ']': N(vm); break;
+
+	/* Jump backward: ..a .=a .!a .>a .<a (to r[a]) */
+	case '.': {
+		a = N(vm); b = N(vm);
+		int cond = (a == '.') ||
+		           (a == '=' && (R('?') & 1)) ||
+		           (a == '!' && !(R('?') & 1)) ||
+		           (a == '>' && (R('?') & 2)) ||
+		           (a == '<' && (R('?') & 4));
+		if (cond) PC = R(b);
+		break;
+	}
+
+	/* Skip forward: {a (sets r[a]=PC, skips to }a), [=a [!a [>a [<a (conditional to ]a) */
+	case '{': {
+		b = N(vm);
+		R(b) = PC;  /* record function entry point */
+		u32 scan = PC, from = PC;
+		while (scan < vm->size - 1) {
+			if (M(scan) == '}' && M(scan + 1) == b) { PC = scan + 2; break; }
+			scan++;
+		}
+		PROF(skips++);
+		glyph_prof_scan(vm, scan - from);
+		break;
+	}
+	case '[': {
+		a = N(vm); b = N(vm);
+		int cond = (a == '=' && (R('?') & 1)) ||
+		           (a == '!' && !(R('?') & 1)) ||
+		           (a == '>' && (R('?') & 2)) ||
+		           (a == '<' && (R('?') & 4));
+		if (cond) {
+			u32 scan = PC, from = PC;
 			while (scan < vm->size - 1) {
-				if (M(scan) == '}' && M(scan + 1) == b) { PC = scan + 2; break; }
+				if (M(scan) == ']' && M(scan + 1) == b) { PC = scan + 2; break; }
 				scan++;
 			}
-			break;
+			PROF(skips++);
+			glyph_prof_scan(vm, scan - from);
 		}
-		case '[': {
-			a = N(vm); b = N(vm);
-			int cond = (a == '=' && (R('?') & 1)) ||
-			           (a == '!' && !(R('?') & 1)) ||
-			           (a == '>' && (R('?') & 2)) ||
-			           (a == '<' && (R('?') & 4));
-			if (cond) {
-				u32 scan = PC;
-				while (scan < vm->size - 1) {
-					if (M(scan) == ']' && M(scan + 1) == b) { PC = scan + 2; break; }
-					scan++;
-				}
-			}
+		break;
+	}
+
+	/* Call/Return: ;a , */
+	case ';':
+		a = N(vm);
+		if (vm->sp == vm->depth) { PC = at; vm->halt = 1; vm->trap = GLYPH_TRAP_OVERFLOW; break; }
+		if (R(a) < vm->size) PROF(call[R(a)]++);
+		vm->stk[vm->sp++] = PC; PC = R(a);
+		break;
+	case ',':
+		if (!vm->sp) { PC = at; vm->halt = 1; vm->trap = GLYPH_TRAP_UNDERFLOW; break; }
+		PC = vm->stk[--vm->sp];
+		break;
+
+	case 0: vm->halt = 1; break;
+	case ' ':
+	case '\f':
+	case '\n':
+	case '\v':
+	case '\r':
+	case '\t': break;
+	default: vm->halt = 1; vm->trap = GLYPH_TRAP_RUNE; break;
+	}
+}
+
+/* ──────────────────────────────────────────────────────────────────────────
+ * Predecoded engine: each rune is decoded once into a GlyphOp at its address.
+ * Slots start zeroed (OP_DECODE) and are reset whenever their bytes change.
+ * ────────────────────────────────────────────────────────────────────────── */
+
+#define GLYPH_OPS(X) \
+	X(DECODE) X(SLOW) X(HALT) X(TRAP) X(NOP) \
+	X(ADD) X(SUB) X(MUL) X(DIV) X(MOD) \
+	X(AND) X(OR) X(XOR) X(NOT) X(SHL) X(SHR) \
+	X(ADDI) X(SUBI) X(ANDI) X(SHLI) X(SHRI) \
+	X(COPY) X(LIT) X(LOAD) X(STORE) X(IN) X(OUT) \
+	X(CMP) X(MARK) \
+	X(JMP) X(JEQ) X(JNE) X(JGT) X(JLT) \
+	X(FUNC) X(SEQ) X(SNE) X(SGT) X(SLT) \
+	X(CALL) X(RET) X(MOVE) X(FILL) X(MCMP) \
+	X(LOAD16) X(STORE16) X(LOAD32) X(STORE32) \
+	X(CJEQ) X(CJNE) X(CJGT) X(CJLT) X(OUTL) X(LITS)
+
+#define GLYPH_ENUM(n) OP_##n,
+enum { GLYPH_OPS(GLYPH_ENUM) };
+#undef GLYPH_ENUM
+
+#define D(x) vm->reg[x]
+
+/* Decode the single rune at pc into o, as glyph-ops.h lays it out */
+static void glyph_decode_at(Glyph *vm, u32 pc, GlyphOp *o) {
+	const u8 *p = vm->mem + pc;
+	const char *args = "";
+	u8 op = OP_TRAP, len = 1, moded = 0;
+	u32 v[3] = { 0, 0, 0 };
+
+	switch (p[0]) {
+#define GLYPH_RUNE(r, l, m) case r: op = OP_NOP; len = l; moded = m; break;
+	GLYPH_RUNES(GLYPH_RUNE)
+#undef GLYPH_RUNE
+	}
+
+	/* Runes cut off by the end of memory keep their byte-at-a-time quirks */
+	if (len > vm->size - pc) {
+		o->op = OP_SLOW; o->len = 0;
+		return;
+	}
+
+	switch (p[0] << 8 | (moded ? p[1] : 0)) {
+#define GLYPH_FORM(r, m, n, ar, t) case (r) << 8 | (m): op = OP_##n; args = ar; break;
+	GLYPH_FORMS(GLYPH_FORM)
+#undef GLYPH_FORM
+	}
+
+	p += 1 + moded;
+	for (int i = 0; args[i]; i++) {
+		switch (args[i]) {
+		case 'r': v[i] = p[i] & 127; break;
+		case 'n': v[i] = p[i]; break;
+		case 'l': v[2] = p[i]; break;
+		case 'h': v[2] = GLYPH_HEX(p[i]); break;
+		}
+	}
+
+	o->op = op; o->len = len; o->a = v[0]; o->b = v[1]; o->c = v[2];
+}
+
+/* ──────────────────────────────────────────────────────────────────────────
+ * Superinstructions: idioms generated code is full of, decoded into one slot
+ * that retires all of their runes (and any whitespace between them).
+ *   CJxx  ?ab .=t     compare and leap      c = t | steps << 8
+ *   OUTL  :'pX #>pv   write a literal port  a = p, b = v, c = X | steps << 8
+ *   LITS  :0a1 <aab.. a run of literals and arithmetic on them that leaves
+ *                     one register with up to 16 bits and maybe one with up
+ *                     to 8, like G_LOAD16    c = A | B << 16 | steps << 24
+ * Runs out of budget mid-way fall back to executing the first rune alone.
+ * ────────────────────────────────────────────────────────────────────────── */
+
+/* Decode the rune after *q into o, skipping whitespace; false past limit */
+static bool glyph_fuse_next(Glyph *vm, u32 *q, u32 limit, u32 *steps, GlyphOp *o) {
+	for (;;) {
+		if (*q >= vm->size) return false;
+		glyph_decode_at(vm, *q, o);
+		if (o->op == OP_SLOW || *q + o->len > limit) return false;
+		*q += o->len;
+		++*steps;
+		if (o->op != OP_NOP) return true;
+	}
+}
+
+/* Value of a binary ALU op on constants */
+static u32 glyph_fold(u8 op, u32 x, u32 y) {
+	switch (op) {
+	case OP_ADD: case OP_ADDI: return x + y;
+	case OP_SUB: case OP_SUBI: return x - y;
+	case OP_MUL: return x * y;
+	case OP_DIV: return y ? x / y : 0;
+	case OP_MOD: return y ? x % y : 0;
+	case OP_AND: case OP_ANDI: return x & y;
+	case OP_OR:  return x | y;
+	case OP_XOR: return x ^ y;
+	case OP_SHL: case OP_SHLI: return x << (y & 31);
+	default:     return x >> (y & 31);
+	}
+}
+
+static bool glyph_fuse_lits(Glyph *vm, u32 pc, u32 limit) {
+	GlyphOp *o = &vm->code[pc], n;
+	u32 val[128], q = pc + o->len, steps = 1, end = 0, c = 0;
+	u8 reg[2] = { o->a, o->a }, nreg = 1, a = 0, b = 0;
+	bool known[128] = { false };
+	known[o->a] = true; val[o->a] = o->c;
+
+	for (;;) {
+		u32 st = steps, r;
+		if (!glyph_fuse_next(vm, &q, limit, &st, &n) || n.a == '.') break;
+		if (n.op == OP_LIT) r = n.c;
+		else if (n.op < OP_ADD || n.op > OP_COPY || !known[n.b]) break;
+		else if (n.op == OP_COPY) r = val[n.b];
+		else if (n.op == OP_NOT) r = ~val[n.b];
+		else if (n.op >= OP_ADDI) r = glyph_fold(n.op, val[n.b], n.c);
+		else if (!known[n.c]) break;  /* c is a register for the rest */
+		else r = glyph_fold(n.op, val[n.b], val[n.c]);
+		if (!known[n.a]) {
+			if (nreg == 2) break;
+			reg[nreg++] = n.a;
+		}
+		known[n.a] = true; val[n.a] = r;
+		steps = st;
+		/* Keep the longest prefix whose result fits the slot */
+		u32 v0 = val[reg[0]], v1 = val[reg[1]];
+		if (nreg == 1) {  /* a G_LOAD16: b = a is written first, a wins */
+			if (v0 > 0xFFFF) continue;
+			a = b = reg[0]; c = v0;
+		} else if (v0 <= 0xFFFF && v1 <= 0xFF) { a = reg[0]; b = reg[1]; c = v0 | v1 << 16; }
+		else if (v1 <= 0xFFFF && v0 <= 0xFF) { a = reg[1]; b = reg[0]; c = v1 | v0 << 16; }
+		else continue;
+		end = q;
+		c |= steps << 24;
+	}
+	if (!end) return false;
+	o->op = OP_LITS; o->len = end - pc; o->a = a; o->b = b; o->c = c;
+	return true;
+}
+
+static void glyph_fuse(Glyph *vm, u32 pc) {
+	GlyphOp *o = &vm->code[pc], n;
+	u32 q = pc + o->len, steps = 1;
+	u32 limit = (vm->size - pc > GLYPH_FUSE_MAX) ? pc + GLYPH_FUSE_MAX : vm->size;
+#ifdef GLYPH_PROFILE
+	return;  /* profiles count each rune at its own address */
+#endif
+
+	if (o->op == OP_CMP && o->a != '.' && o->b != '.') {  /* PC moves on */
+		if (!glyph_fuse_next(vm, &q, limit, &steps, &n) ||
+		    n.op < OP_JEQ || n.op > OP_JLT) return;
+		o->op = OP_CJEQ + (n.op - OP_JEQ);
+		o->c = n.a | steps << 8;
+	} else if (o->op == OP_LIT && o->a != '.') {  /* :0.x is a leap */
+		if (glyph_fuse_lits(vm, pc, limit)) goto fused;
+		if (!glyph_fuse_next(vm, &q, limit, &steps, &n) ||
+		    n.op != OP_OUT || n.a != o->a) return;
+		o->op = OP_OUTL;
+		o->b = n.b;
+		o->c |= steps << 8;
+	} else {
+		return;
+	}
+	o->len = q - pc;
+fused:;
+	u32 r = pc >> vm->fuse_shift;
+	vm->fused[r / 32] |= 1u << (r % 32);
+}
+
+static void glyph_decode(Glyph *vm, u32 pc) {
+	glyph_decode_at(vm, pc, &vm->code[pc]);
+	glyph_fuse(vm, pc);
+}
+
+/* Where {/[ at pc lands: scan for the end marker `end`,a once, then reuse the
+ * target (kept in the slot's c, stamped with the generation in b) */
+static u32 glyph_skip(Glyph *vm, u32 pc, u8 end) {
+	GlyphOp *o = &vm->code[pc];
+	PROF(skips++);
+	if (o->c && o->b == vm->gen) return o->c;
+	u32 scan = PC, to = PC;
+	while (scan < vm->size - 1) {
+		if (M(scan) == end && M(scan + 1) == o->a) { to = scan + 2; break; }
+		scan++;
+	}
+	glyph_prof_scan(vm, scan - PC);
+	o->c = to; o->b = vm->gen;
+	return to;
+}
+
+#ifdef GLYPH_JIT_X64
+/* ──────────────────────────────────────────────────────────────────────────
+ * JIT: a block is  void fn(u32 *reg, const u8 *mem, u32 mask)  with reg in
+ * rdi, mem in rsi and the address mask moved to r8d. Each rune is a fixed
+ * template over eax/ecx/edx against the reg[] slots in memory.
+ * ────────────────────────────────────────────────────────────────────────── */
+
+typedef void (*GlyphNative)(u32 *reg, const u8 *mem, u32 mask);
+
+typedef struct {
+	u32 n;    /* runes in the block, all retired by one call */
+	u32 end;  /* PC after the block */
+} GlyphBlock;
+
+#define X64_BLOCK_MAX (GLYPH_JIT_MAX * 64 + 16)  /* worst-case bytes */
+
+static u8 *x64_u32(u8 *p, u32 v) {
+	p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+	return p + 4;
+}
+
+/* opcode  r32, [rdi + 4*x]  (r: 0 eax, 1 ecx) */
+static u8 *x64_reg(u8 *p, u8 opc, u8 r, u8 x) {
+	*p++ = opc;
+	*p++ = 0x87 | r << 3;
+	return x64_u32(p, x * 4u);
+}
+
+static u8 *x64_imm(u8 *p, u8 x, u32 v) {
+	return x64_u32(x64_reg(p, 0xC7, 0, x), v);  /* mov dword [rdi+4x], v */
+}
+
+static u8 *x64_bytes(u8 *p, const char *b, int n) {
+	memcpy(p, b, n);
+	return p + n;
+}
+
+static void glyph_jit_flush(Glyph *vm) {
+	GlyphJit *j = vm->jit;
+	j->used = 0;
+	memset(j->entry, 0, vm->size * sizeof(u32));
+	memset(j->heat, 0, vm->size);
+	memset(j->pages, 0, GLYPH_DIRTY_WORDS(vm->size) * sizeof(u32));
+	j->flushes++;
+}
+
+/* mem[lo, hi) changed: drop every block if any of it was compiled */
+static void glyph_jit_forget(Glyph *vm, u32 lo, u32 hi) {
+	for (u32 a = lo; a < hi; a = (a | (GLYPH_PAGE - 1)) + 1) {
+		u32 page = a / GLYPH_PAGE;
+		if (vm->jit->pages[page / 32] & 1u << (page % 32)) {
+			glyph_jit_flush(vm);
+			return;
+		}
+	}
+}
+
+/* Does the rune read register x? Only '.' matters: it must hold the next PC */
+static bool glyph_jit_reads(const GlyphOp *o, u8 x) {
+	switch (o->op) {
+	case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+	case OP_AND: case OP_OR:  case OP_XOR: case OP_SHL: case OP_SHR:
+		return o->b == x || o->c == x;
+	case OP_ADDI: case OP_SUBI: case OP_ANDI: case OP_SHLI: case OP_SHRI:
+	case OP_NOT: case OP_COPY: case OP_LOAD:
+		return o->b == x;
+	case OP_CMP:
+		return o->a == x || o->b == x;
+	}
+	return false;
+}
+
+static void glyph_jit_compile(Glyph *vm, u32 t) {
+	GlyphJit *j = vm->jit;
+	if (j->cap - j->used < sizeof(GlyphBlock) + X64_BLOCK_MAX) glyph_jit_flush(vm);
+	if (mprotect(j->buf, j->cap, PROT_READ | PROT_WRITE)) return;
+
+	GlyphBlock *blk = (GlyphBlock *)(j->buf + j->used);
+	u8 *p = (u8 *)(blk + 1);
+	u32 pc = t, n = 0;
+	p = x64_bytes(p, "\x41\x89\xD0", 3);                 /* mov r8d, edx */
+
+	while (n < GLYPH_JIT_MAX && pc < vm->size) {
+		GlyphOp op, *o = &op;
+		glyph_decode_at(vm, pc, o);  /* single runes, never fused */
+		u32 next = pc + o->len;
+		u8 alu = 0;
+
+		if (o->op == OP_NOP) { pc = next; n++; continue; }
+		if (o->op < OP_ADD || o->op > OP_MARK || o->op == OP_STORE ||
+		    o->op == OP_IN || o->op == OP_OUT || (o->op != OP_CMP && o->a == '.'))
+			break;  /* control, I/O, stores and writes to PC stay interpreted */
+		if (glyph_jit_reads(o, '.')) p = x64_imm(p, '.', next);
+
+		switch (o->op) {
+		case OP_ADD: alu = 0x03; break;
+		case OP_SUB: alu = 0x2B; break;
+		case OP_AND: alu = 0x23; break;
+		case OP_OR:  alu = 0x0B; break;
+		case OP_XOR: alu = 0x33; break;
+		case OP_ADDI: alu = 0x05; break;
+		case OP_SUBI: alu = 0x2D; break;
+		case OP_ANDI: alu = 0x25; break;
+		}
+		switch (o->op) {
+		case OP_ADD: case OP_SUB: case OP_AND: case OP_OR: case OP_XOR:
+			p = x64_reg(p, 0x8B, 0, o->b);               /* mov eax, b */
+			p = x64_reg(p, alu, 0, o->c);                /* op  eax, c */
+			break;
+		case OP_MUL:
+			p = x64_reg(p, 0x8B, 0, o->b);
+			*p++ = 0x0F;
+			p = x64_reg(p, 0xAF, 0, o->c);               /* imul eax, c */
+			break;
+		case OP_DIV: case OP_MOD:
+			p = x64_reg(p, 0x8B, 1, o->c);               /* mov ecx, c */
+			p = x64_reg(p, 0x8B, 0, o->b);               /* mov eax, b */
+			p = x64_bytes(p, "\x85\xC9", 2);             /* test ecx, ecx */
+			if (o->op == OP_DIV)                         /* jz 0; xor edx, edx; div ecx */
+				p = x64_bytes(p, "\x74\x06\x31\xD2\xF7\xF1\xEB\x02", 8);
+			else                                         /* ...; mov eax, edx */
+				p = x64_bytes(p, "\x74\x08\x31\xD2\xF7\xF1\x89\xD0\xEB\x02", 10);
+			p = x64_bytes(p, "\x31\xC0", 2);             /* 0: xor eax, eax */
+			break;
+		case OP_NOT:
+			p = x64_reg(p, 0x8B, 0, o->b);
+			p = x64_bytes(p, "\xF7\xD0", 2);             /* not eax */
+			break;
+		case OP_SHL: case OP_SHR:
+			p = x64_reg(p, 0x8B, 1, o->c);
+			p = x64_reg(p, 0x8B, 0, o->b);
+			p = x64_bytes(p, o->op == OP_SHL ? "\xD3\xE0" : "\xD3\xE8", 2);
+			break;
+		case OP_ADDI: case OP_SUBI: case OP_ANDI:
+			p = x64_reg(p, 0x8B, 0, o->b);
+			*p++ = alu;
+			p = x64_u32(p, o->c);                        /* op  eax, imm32 */
+			break;
+		case OP_SHLI: case OP_SHRI:
+			p = x64_reg(p, 0x8B, 0, o->b);
+			p = x64_bytes(p, o->op == OP_SHLI ? "\xC1\xE0" : "\xC1\xE8", 2);
+			*p++ = o->c & 31;                            /* shl/shr eax, imm8 */
+			break;
+		case OP_COPY:
+			p = x64_reg(p, 0x8B, 0, o->b);
+			break;
+		case OP_LIT:
+			p = x64_imm(p, o->a, o->c);
+			break;
+		case OP_MARK:
+			p = x64_imm(p, o->a, next);
+			break;
+		case OP_LOAD:
+			p = x64_reg(p, 0x8B, 0, o->b);
+			p = x64_bytes(p, "\x44\x21\xC0"              /* and eax, r8d */
+			                 "\x0F\xB6\x04\x06", 7);     /* movzx eax, byte [rsi+rax] */
+			break;
+		case OP_CMP:
+			p = x64_reg(p, 0x8B, 0, o->a);
+			p = x64_reg(p, 0x3B, 0, o->b);               /* cmp eax, b */
+			p = x64_bytes(p, "\x0F\x94\xC1"              /* sete cl */
+			                 "\x0F\x97\xC2"              /* seta dl */
+			                 "\x0F\x92\xC0"              /* setb al */
+			                 "\x0F\xB6\xC9\x0F\xB6\xD2\x0F\xB6\xC0"
+			                 "\x8D\x0C\x51"              /* lea ecx, [rcx+rdx*2] */
+			                 "\x8D\x04\x81", 24);        /* lea eax, [rcx+rax*4] */
+			p = x64_reg(p, 0x89, 0, '?');
 			break;
 		}
+		if (o->op != OP_LIT && o->op != OP_MARK && o->op != OP_CMP)
+			p = x64_reg(p, 0x89, 0, o->a);               /* mov a, eax */
+		pc = next;
+		n++;
+	}
+	*p++ = 0xC3;                                         /* ret */
+	blk->n = n;
+	blk->end = pc;
+	mprotect(j->buf, j->cap, PROT_READ | PROT_EXEC);
+	if (n < 2) {  /* not worth a call, now or on later leaps */
+		j->heat[t] = GLYPH_JIT_COLD;
+		return;
+	}
+
+	j->entry[t] = j->used + 1;
+	j->used = (u32)(p - j->buf + 15) & ~15u;
+	j->blocks++;
+	for (u32 a = t; a < pc; a = (a | (GLYPH_PAGE - 1)) + 1) {
+		u32 page = a / GLYPH_PAGE;
+		j->pages[page / 32] |= 1u << (page % 32);
+	}
+}
+
+/* A backward leap or call just landed on PC, which is not cold: run its
+ * block if there is one and the budget covers all of it. Returns the steps
+ * used. */
+static u64 glyph_jit_enter(Glyph *vm, u64 left) {
+	GlyphJit *j = vm->jit;
+	u32 pc = PC;
+	if (!j->entry[pc]) {
+		if (j->heat[pc] >= j->hot || ++j->heat[pc] < j->hot) return 0;
+		glyph_jit_compile(vm, pc);
+		if (!j->entry[pc]) return 0;
+	}
+	const GlyphBlock *blk = (const GlyphBlock *)(j->buf + j->entry[pc] - 1);
+	if (blk->n > left) return 0;
+	((GlyphNative)(void *)(blk + 1))(vm->reg, vm->mem, vm->size - 1);
+	PC = blk->end;
+	return blk->n;
+}
+
+#undef X64_BLOCK_MAX
+#endif /* GLYPH_JIT_X64 */
+
+/* Dispatch: with GCC/Clang labels-as-values every handler ends in its own
+ * indirect jump (direct threading); -DGLYPH_NO_THREADED or other compilers
+ * get a portable switch. Only handlers that can halt re-check vm->halt. */
+#if defined(__GNUC__) && !defined(GLYPH_NO_THREADED)
+#define GLYPH_THREADED
+#endif
+
+#ifdef DEBUG
+#define TRACE() printf("OP: %c(%d) PC: %u\n", vm->mem[pc], vm->mem[pc], pc)
+#else
+#define TRACE()
+#endif
+
+#define FETCH() \
+	if (!left) return 0; \
+	left--; \
+	pc = PC; \
+	if (pc >= vm->size) { vm->halt = 1; return left; } \
+	o = &vm->code[pc]; \
+	PC = pc + o->len; \
+	if (o->op != OP_DECODE) glyph_prof_rune(vm, pc); \
+	TRACE()
+
+#ifdef GLYPH_THREADED
+#define CASE(n) L_##n
+#define NEXT    do { FETCH(); goto *jump[o->op]; } while (0)
+#else
+#define CASE(n) case OP_##n
+#define NEXT    continue
+#endif
+
+#define STOP    if (vm->halt) return left; NEXT
+
+#define COMPARE() do { \
+	u32 va = D(o->a), vb = D(o->b); \
+	R('?') = (va == vb ? 1 : 0) | (va > vb ? 2 : 0) | (va < vb ? 4 : 0); \
+} while (0)
+
+/* A superinstruction retires k runes, or just its first if the budget ends */
+#define FUSED(k) \
+	if (left < (k) - 1) { PC = pc; goto step; } \
+	left -= (k) - 1
+
+/* Taken backward leaps and calls are where the JIT looks for hot code;
+ * forward leaps and cold targets never leave the loop */
+#ifdef GLYPH_JIT_X64
+#define ENTER() do { \
+	if (vm->jit && PC < vm->size && vm->jit->heat[PC] != GLYPH_JIT_COLD) \
+		left -= glyph_jit_enter(vm, left); \
+} while (0)
+#define LEAP(t) do { PC = (t); if (PC <= pc) ENTER(); } while (0)
+#else
+#define ENTER() ((void)0)
+#define LEAP(t) (PC = (t))
+#endif
+
+/* Returns the unused part of the step budget */
+static u64 glyph_run_decoded(Glyph *vm, u64 left) {
+	const GlyphOp *o;
+	u32 pc, x;
+	u8 a;
+
+	if (vm->halt) return left;
+#ifdef GLYPH_THREADED
+	#define GLYPH_LABEL(n) &&L_##n,
+	static const void *const jump[] = { GLYPH_OPS(GLYPH_LABEL) };
+	#undef GLYPH_LABEL
+	NEXT;
+#else
+	for (;;) {
+		FETCH();
+		switch (o->op) {
+#endif
+	CASE(DECODE): glyph_decode(vm, pc); left++; NEXT;
+	CASE(SLOW):
+	step:         glyph_step(vm); STOP;
+	CASE(HALT):   vm->halt = 1; return left;
+	CASE(TRAP):   vm->halt = 1; vm->trap = GLYPH_TRAP_RUNE; return left;
+	CASE(NOP):    NEXT;
+
+	CASE(ADD): D(o->a) = D(o->b) + D(o->c); NEXT;
+	CASE(SUB): D(o->a) = D(o->b) - D(o->c); NEXT;
+	CASE(MUL): D(o->a) = D(o->b) * D(o->c); NEXT;
+	CASE(DIV): x = D(o->c); D(o->a) = x ? D(o->b) / x : 0; NEXT;
+	CASE(MOD): x = D(o->c); D(o->a) = x ? D(o->b) % x : 0; NEXT;
+	CASE(AND): D(o->a) = D(o->b) & D(o->c); NEXT;
+	CASE(OR):  D(o->a) = D(o->b) | D(o->c); NEXT;
+	CASE(XOR): D(o->a) = D(o->b) ^ D(o->c); NEXT;
+	CASE(NOT): D(o->a) = ~D(o->b); NEXT;
+	CASE(SHL): D(o->a) = D(o->b) << (D(o->c) & 31); NEXT;
+	CASE(SHR): D(o->a) = D(o->b) >> (D(o->c) & 31); NEXT;
+	CASE(ADDI): D(o->a) = D(o->b) + o->c; NEXT;
+	CASE(SUBI): D(o->a) = D(o->b) - o->c; NEXT;
+	CASE(ANDI): D(o->a) = D(o->b) & o->c; NEXT;
+	CASE(SHLI): D(o->a) = D(o->b) << (o->c & 31); NEXT;
+	CASE(SHRI): D(o->a) = D(o->b) >> (o->c & 31); NEXT;
+
+	CASE(COPY): D(o->a) = D(o->b); NEXT;
+	CASE(LIT):  D(o->a) = o->c; NEXT;
+	CASE(LOAD): D(o->a) = M(D(o->b)); NEXT;
+	CASE(STORE):
+		glyph_poke(vm, D(o->a) & (vm->size - 1), D(o->b));
+		NEXT;
+	CASE(IN):
+		a = o->a; x = D(o->b) & 255;
+		PROF(in[x]++);
+		if (vm->sense) vm->sense(vm, vm->user, x);
+		D(a) = vm->port[x];
+		STOP;
+	CASE(OUT):
+		x = D(o->a) & 255;
+		PROF(out[x]++);
+		vm->port[x] = D(o->b);
+		if (vm->emit) vm->emit(vm, vm->user, x);
+		STOP;
+
+	CASE(CMP): COMPARE(); NEXT;
+	CASE(MARK): D(o->a) = PC; NEXT;
+
+	CASE(JMP): LEAP(D(o->a)); NEXT;
+	CASE(JEQ): if (R('?') & 1)    LEAP(D(o->a)); NEXT;
+	CASE(JNE): if (!(R('?') & 1)) LEAP(D(o->a)); NEXT;
+	CASE(JGT): if (R('?') & 2)    LEAP(D(o->a)); NEXT;
+	CASE(JLT): if (R('?') & 4)    LEAP(D(o->a)); NEXT;
+
+	CASE(FUNC): R(o->a) = PC; PC = glyph_skip(vm, pc, '}'); NEXT;
+	CASE(SEQ): if (R('?') & 1)    PC = glyph_skip(vm, pc, ']'); NEXT;
+	CASE(SNE): if (!(R('?') & 1)) PC = glyph_skip(vm, pc, ']'); NEXT;
+	CASE(SGT): if (R('?') & 2)    PC = glyph_skip(vm, pc, ']'); NEXT;
+	CASE(SLT): if (R('?') & 4)    PC = glyph_skip(vm, pc, ']'); NEXT;
 
-		/* Call/Return: ;a , */
-		case ';': a = N(vm); vm->stk[vm->sp++] = PC; PC = R(a); break;
-		case ',': PC = vm->stk[--vm->sp]; break;
-
-		case 0: vm->halt = 1; break;
-		case ' ':
-		case '\f':
-		case '\n':
-		case '\v':
-		case '\r':
-		case '\t': break;
-		default: vm->halt = 1; break;
+	CASE(CALL):
+		if (vm->sp == vm->depth) goto overflow;
+		x = D(o->a);
+		if (x < vm->size) PROF(call[x]++);
+		vm->stk[vm->sp++] = PC; PC = x; ENTER();
+		NEXT;
+	CASE(RET):
+		if (!vm->sp) goto underflow;
+		PC = vm->stk[--vm->sp];
+		NEXT;
+	overflow:  PC = pc; vm->halt = 1; vm->trap = GLYPH_TRAP_OVERFLOW; return left;
+	underflow: PC = pc; vm->halt = 1; vm->trap = GLYPH_TRAP_UNDERFLOW; return left;
+
+	CASE(MOVE): glyph_move(vm, D(o->a), D(o->b), D(o->c)); NEXT;
+	CASE(FILL): glyph_fill(vm, D(o->a), D(o->b), D(o->c)); NEXT;
+	CASE(MCMP): R('?') = glyph_mcmp(vm, D(o->a), D(o->b), D(o->c)); NEXT;
+
+	CASE(LOAD16):  D(o->a) = glyph_load(vm, D(o->b), 2); NEXT;
+	CASE(STORE16): glyph_store(vm, D(o->a), D(o->b), 2); NEXT;
+	CASE(LOAD32):  D(o->a) = glyph_load(vm, D(o->b), 4); NEXT;
+	CASE(STORE32): glyph_store(vm, D(o->a), D(o->b), 4); NEXT;
+
+	CASE(CJEQ): FUSED(o->c >> 8); COMPARE(); if (R('?') & 1)    LEAP(D(o->c & 127)); NEXT;
+	CASE(CJNE): FUSED(o->c >> 8); COMPARE(); if (!(R('?') & 1)) LEAP(D(o->c & 127)); NEXT;
+	CASE(CJGT): FUSED(o->c >> 8); COMPARE(); if (R('?') & 2)    LEAP(D(o->c & 127)); NEXT;
+	CASE(CJLT): FUSED(o->c >> 8); COMPARE(); if (R('?') & 4)    LEAP(D(o->c & 127)); NEXT;
+	CASE(OUTL):
+		FUSED(o->c >> 8);
+		x = o->c & 255;
+		D(o->a) = x;
+		PROF(out[x]++);
+		vm->port[x] = D(o->b);
+		if (vm->emit) vm->emit(vm, vm->user, x);
+		STOP;
+	CASE(LITS):
+		FUSED(o->c >> 24);
+		D(o->b) = (o->c >> 16) & 255;
+		D(o->a) = o->c & 0xFFFF;
+		NEXT;
+#ifndef GLYPH_THREADED
 		}
 	}
+#endif
+}
+
+#undef LEAP
+#undef ENTER
+#undef FUSED
+#undef COMPARE
+#undef STOP
+#undef NEXT
+#undef CASE
+#undef FETCH
+#undef TRACE
+
+GlyphStatus glyph_run_for(Glyph *vm, u64 max_steps) {
+	u64 left = max_steps;
+	if (vm->code) left = glyph_run_decoded(vm, left);
+	else while (!vm->halt && left) { glyph_prof_rune(vm, PC); glyph_step(vm); left--; }
+	vm->steps += max_steps - left;
+	if (!vm->halt) return GLYPH_BUDGET;
+	return vm->trap ? GLYPH_TRAPPED : GLYPH_HALTED;
+}
+
+void glyph_run(Glyph *vm) {
+	glyph_run_for(vm, UINT64_MAX);
 }
 
 void glyph_init(Glyph *vm, u8 *mem, u32 size) {
 	memset(vm, 0, sizeof(Glyph));
 	vm->mem = mem;
 	vm->size = size;
+	vm->stk = vm->stk0;
+	vm->depth = GLYPH_STACK;
+}
+
+int glyph_stack(Glyph *vm, u32 *stk, u32 depth) {
+	if (!stk) { stk = vm->stk0; depth = GLYPH_STACK; }
+	if (vm->sp > depth) return -1;
+	memmove(stk, vm->stk, vm->sp * sizeof(u32));
+	vm->stk = stk;
+	vm->depth = depth;
+	return 0;
+}
+
+void glyph_predecode(Glyph *vm, GlyphOp *code) {
+	vm->code = code;
+	vm->fuse_shift = 6;
+	while ((vm->size - 1) >> vm->fuse_shift >= 256) vm->fuse_shift++;
+	glyph_clear(vm);
+#ifdef GLYPH_JIT_X64
+	if (vm->jit) glyph_jit_flush(vm);
+#endif
+}
+
+/* The host changed mem[addr, addr+len): drop decoded runes and skip targets */
+void glyph_touch(Glyph *vm, u32 addr, u32 len) {
+	if (addr >= vm->size || !len) return;
+	glyph_wrote(vm, addr, len);
+	if (vm->code) glyph_reskip(vm);
+}
+
+void glyph_track(Glyph *vm, u32 *dirty) {
+	memset(dirty, 0, GLYPH_DIRTY_WORDS(vm->size) * sizeof(u32));
+	vm->dirty = dirty;
+	vm->base = NULL;
+}
+
+/* Copy the pages that differ between mem and snap->mem, in either direction.
+ * Without a clean base every page is copied. Returns the bytes copied. */
+static u32 glyph_sync(Glyph *vm, const GlyphSnap *snap, bool restore) {
+	u32 page = GLYPH_PAGE < vm->size ? GLYPH_PAGE : vm->size, done = 0;
+	bool all = !vm->dirty || vm->base != snap || vm->base_gen != snap->gen;
+	for (u32 w = 0; w < GLYPH_DIRTY_WORDS(vm->size); w++) {
+		u32 bits = all ? ~0u : vm->dirty[w];
+		for (u32 i = 0; i < 32 && bits >> i; i++) {
+			u32 addr = (w * 32 + i) * GLYPH_PAGE;
+			if (!(bits >> i & 1)) continue;
+			if (addr >= vm->size) break;
+			if (restore) {
+				memcpy(vm->mem + addr, snap->mem + addr, page);
+				if (vm->code) glyph_forget(vm, addr, page);
+			} else {
+				memcpy(snap->mem + addr, vm->mem + addr, page);
+			}
+			done += page;
+		}
+		if (vm->dirty) vm->dirty[w] = 0;
+	}
+	vm->base = snap;
+	vm->base_gen = snap->gen;
+	return done;
+}
+
+int glyph_snapshot(Glyph *vm, GlyphSnap *snap) {
+	if (!snap->stk && vm->sp > GLYPH_STACK) return -1;
+	glyph_sync(vm, snap, false);
+	vm->base_gen = ++snap->gen;
+	snap->vm = *vm;
+	memcpy(snap->stk ? snap->stk : snap->vm.stk0, vm->stk, vm->sp * sizeof(u32));
+	return 0;
+}
+
+int glyph_restore(Glyph *vm, const GlyphSnap *snap) {
+	if (snap->vm.size != vm->size || snap->vm.sp > vm->depth) return -1;
+	if (glyph_sync(vm, snap, true) && vm->code) glyph_reskip(vm);
+	Glyph keep = *vm;
+	*vm = snap->vm;
+	vm->mem = keep.mem;
+	vm->emit = keep.emit; vm->sense = keep.sense; vm->user = keep.user;
+	vm->code = keep.code; vm->jit = keep.jit; vm->prof = keep.prof;
+	memcpy(vm->fused, keep.fused, sizeof(vm->fused));
+	vm->fuse_shift = keep.fuse_shift;
+	vm->dirty = keep.dirty; vm->base = keep.base; vm->base_gen = keep.base_gen;
+	vm->gen = keep.gen;
+	vm->stk = keep.stk; vm->depth = keep.depth;
+	memcpy(vm->stk, snap->stk ? snap->stk : snap->vm.stk0, vm->sp * sizeof(u32));
+	return 0;
+}
+
+#ifdef GLYPH_PROFILE
+int glyph_profile_init(Glyph *vm, GlyphProfile *prof) {
+	memset(prof, 0, sizeof(*prof));
+	prof->pc = calloc(vm->size, sizeof(u64));
+	prof->call = calloc(vm->size, sizeof(u64));
+	if (!prof->pc || !prof->call) {
+		glyph_profile_free(vm, prof);
+		return -1;
+	}
+	vm->prof = prof;
+	return 0;
+}
+
+void glyph_profile_free(Glyph *vm, GlyphProfile *prof) {
+	free(prof->pc);
+	free(prof->call);
+	memset(prof, 0, sizeof(*prof));
+	if (vm->prof == prof) vm->prof = NULL;
+}
+
+/* Indices of the k largest nonzero counts, largest first; returns how many */
+static u32 glyph_prof_top(const u64 *count, u32 n, u32 *top, u32 k) {
+	u32 found = 0;
+	for (u32 i = 0; i < n; i++) {
+		if (!count[i] || (found == k && count[i] <= count[top[k - 1]])) continue;
+		u32 j = (found < k) ? found++ : k - 1;
+		for (; j > 0 && count[top[j - 1]] < count[i]; j--) top[j] = top[j - 1];
+		top[j] = i;
+	}
+	return found;
+}
+
+/* Rune bytes as printed in reports: the character, or its hex value */
+static const char *glyph_prof_name(u8 op, char *buf) {
+	if (isgraph(op)) snprintf(buf, 8, "%c", op);
+	else snprintf(buf, 8, "0x%02x", op);
+	return buf;
+}
+
+static double glyph_prof_pct(u64 n, u64 total) {
+	return total ? 100.0 * n / total : 0;
+}
+
+#define GLYPH_PROF_TOP 20
+
+void glyph_profile_report(Glyph *vm, FILE *out) {
+	const GlyphProfile *p = vm->prof;
+	u32 top[GLYPH_PROF_TOP], n;
+	u64 runes = 0, calls = 0;
+	char name[8];
+	if (!p) return;
+	for (int i = 0; i < 256; i++) runes += p->op[i];
+	for (u32 i = 0; i < vm->size; i++) calls += p->call[i];
+
+	fprintf(out, "profile: %llu runes, %llu calls, %llu skips\n",
+	        (unsigned long long)runes, (unsigned long long)calls,
+	        (unsigned long long)p->skips);
+
+	fprintf(out, "\nrunes:\n");
+	n = glyph_prof_top(p->op, 256, top, GLYPH_PROF_TOP);
+	for (u32 i = 0; i < n; i++)
+		fprintf(out, "  %-6s %14llu %6.2f%%\n", glyph_prof_name(top[i], name),
+		        (unsigned long long)p->op[top[i]], glyph_prof_pct(p->op[top[i]], runes));
+
+	fprintf(out, "\nhot addresses:\n");
+	n = glyph_prof_top(p->pc, vm->size, top, GLYPH_PROF_TOP);
+	for (u32 i = 0; i < n; i++) {
+		u32 a = top[i], len = 0;
+		while (len < 4 && a + len < vm->size && isgraph(vm->mem[a + len])) len++;
+		fprintf(out, "  0x%04x %-6.*s %14llu %6.2f%%\n", a, (int)len,
+		        (const char *)vm->mem + a, (unsigned long long)p->pc[a],
+		        glyph_prof_pct(p->pc[a], runes));
+	}
+
+	fprintf(out, "\ncall targets:\n");
+	n = glyph_prof_top(p->call, vm->size, top, GLYPH_PROF_TOP);
+	for (u32 i = 0; i < n; i++)
+		fprintf(out, "  0x%04x        %14llu %6.2f%%\n", top[i],
+		        (unsigned long long)p->call[top[i]], glyph_prof_pct(p->call[top[i]], calls));
+
+	fprintf(out, "\nskip searches: %llu, %llu bytes scanned\n",
+	        (unsigned long long)p->scans, (unsigned long long)p->scanned);
+	for (int k = 0; k < 33; k++) {
+		if (!p->scan_len[k]) continue;
+		u64 lo = k ? 1ull << (k - 1) : 0, hi = k ? (1ull << k) - 1 : 0;
+		fprintf(out, "  %6llu-%-7llu %14llu\n", (unsigned long long)lo,
+		        (unsigned long long)hi, (unsigned long long)p->scan_len[k]);
+	}
+
+	fprintf(out, "\nports:          in            out\n");
+	for (int i = 0; i < 256; i++) {
+		if (!p->in[i] && !p->out[i]) continue;
+		fprintf(out, "  %-6s %14llu %14llu\n", glyph_prof_name(i, name),
+		        (unsigned long long)p->in[i], (unsigned long long)p->out[i]);
+	}
+}
+
+/* Counters indexed by address, as [[address, count], ...] */
+static void glyph_prof_json_addrs(FILE *out, const u64 *count, u32 n) {
+	const char *sep = "";
+	fputc('[', out);
+	for (u32 i = 0; i < n; i++) {
+		if (!count[i]) continue;
+		fprintf(out, "%s[%u,%llu]", sep, i, (unsigned long long)count[i]);
+		sep = ",";
+	}
+	fputc(']', out);
+}
+
+void glyph_profile_json(Glyph *vm, FILE *out) {
+	const GlyphProfile *p = vm->prof;
+	const char *sep = "";
+	if (!p) return;
+
+	fprintf(out, "{\"ops\":{");
+	for (int i = 0; i < 256; i++) {
+		if (!p->op[i]) continue;
+		if (isgraph(i) && i != '"' && i != '\\') fprintf(out, "%s\"%c\"", sep, i);
+		else fprintf(out, "%s\"\\u%04x\"", sep, i);
+		fprintf(out, ":%llu", (unsigned long long)p->op[i]);
+		sep = ",";
+	}
+	fprintf(out, "},\n\"pc\":");
+	glyph_prof_json_addrs(out, p->pc, vm->size);
+	fprintf(out, ",\n\"calls\":");
+	glyph_prof_json_addrs(out, p->call, vm->size);
+	fprintf(out, ",\n\"skips\":{\"taken\":%llu,\"scans\":%llu,\"scanned\":%llu,\"scan_len\":[",
+	        (unsigned long long)p->skips, (unsigned long long)p->scans,
+	        (unsigned long long)p->scanned);
+	for (int k = 0; k < 33; k++)
+		fprintf(out, "%s%llu", k ? "," : "", (unsigned long long)p->scan_len[k]);
+	fprintf(out, "]},\n\"ports\":[");
+	sep = "";
+	for (int i = 0; i < 256; i++) {
+		if (!p->in[i] && !p->out[i]) continue;
+		fprintf(out, "%s{\"port\":%d,\"in\":%llu,\"out\":%llu}", sep, i,
+		        (unsigned long long)p->in[i], (unsigned long long)p->out[i]);
+		sep = ",";
+	}
+	fprintf(out, "]}\n");
+}
+
+#undef GLYPH_PROF_TOP
+#endif
+
+#ifdef GLYPH_JIT
+int glyph_jit_init(Glyph *vm, GlyphJit *jit, u32 cap) {
+	memset(jit, 0, sizeof(*jit));
+#ifdef GLYPH_JIT_X64
+	if (!vm->code) return -1;
+	cap = (cap < 0x10000) ? 0x10000 : (cap + 4095) & ~4095u;
+	jit->buf = mmap(NULL, cap, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	jit->entry = calloc(vm->size, sizeof(u32));
+	jit->heat = calloc(vm->size, 1);
+	jit->pages = calloc(GLYPH_DIRTY_WORDS(vm->size), sizeof(u32));
+	if (jit->buf == MAP_FAILED) jit->buf = NULL;
+	jit->cap = cap;
+	jit->hot = GLYPH_JIT_HOT;
+	if (!jit->buf || !jit->entry || !jit->heat || !jit->pages) {
+		glyph_jit_free(vm, jit);
+		return -1;
+	}
+	vm->jit = jit;
+	return 0;
+#else
+	(void)vm; (void)cap;
+	return -1;
+#endif
+}
+
+void glyph_jit_free(Glyph *vm, GlyphJit *jit) {
+#ifdef GLYPH_JIT_X64
+	if (jit->buf) munmap(jit->buf, jit->cap);
+#endif
+	free(jit->entry);
+	free(jit->heat);
+	free(jit->pages);
+	memset(jit, 0, sizeof(*jit));
+	if (vm->jit == jit) vm->jit = NULL;
 }
+#endif
 
+#undef PROF
+#undef D
 #undef R
 #undef M
 #undef PC
@@ -8,76 +8,359 @@
  *   'c' (99)  - read:   input character (set before callback)
  *   'o' (111) - write:  write byte to stdout
  *   'e' (101) - error:  write byte to stderr
+ *   'B' (66)  - batch:  buffer address for batch input
+ *   'b' (98)  - batch:  buffer capacity (0 = one byte per event)
  * 
  * System:
  *   'X' (88)  - exit:   exit with code
  * 
  * Input model (like UXN):
- *   1. Program runs to completion
+ *   1. Program runs to completion (reading 'c' pulls the next stdin byte)
  *   2. For each stdin char: set port['c'], call vector
  *   3. When stdin exhausted, exit normally
+ * In batch mode ('b' nonzero) step 2 instead copies up to 'b' bytes to
+ * memory at 'B', sets port['c'] to the count and calls the vector once.
+ * stdin is read in large blocks either way.
  * 
- * Usage: ./glyph <program.glyph> [args...]
- *        ./glyph -e "<code>"
+ * Output ('o', 'e') is buffered: flushed when full, on newline when the
+ * stream is a TTY, before reading 'c', and on exit. -u writes every byte.
+ *
+ * Memory is 64KB unless -m picks another power of two. Program files are
+ * mmap'ed privately over the start of memory, so pages the program never
+ * touches are never read.
+ *
+ * The call stack holds 64K return addresses unless -r picks another depth.
+ * Calling past it, or returning with nothing on it, stops the program with
+ * an error instead of wrapping.
+ *
+ * Built with -DGLYPH_JIT, -j turns on the x86-64 native tier for hot loops.
+ * Built with -DGLYPH_PROFILE (make glyph-prof), -p file counts every rune,
+ * call, skip and port access; at exit a summary goes to stderr and every
+ * counter to file as JSON.
+ *
+ * -s file samples the guest call stack about every 1000 steps and writes
+ * the stacks in collapsed form for flame graph tools; -l map names frames
+ * after the labels in a `;   name = 0x0123` listing, as the generators
+ * print. This works in every build and costs around 1%.
+ *
+ * Usage: ./glyph [options] <program.glyph> [args...]
+ *        ./glyph [options] -e "<code>"
  *        echo "input" | ./glyph program.glyph
  */
 
+#define _DEFAULT_SOURCE
 #define GLYPH_IMPL
+#define GLYPH_SAMPLE_IMPL
 #include "glyph.h"
+#include "glyph-sample.h"
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-/* Memory size: 64KB */
+/* Default memory size: 64KB */
 #define MEM_SIZE 0x10000
 
+/* Default call stack depth: 64K frames */
+#define STACK_DEPTH 0x10000
+
 /* Device ports */
 #define CON_VECTOR  'C'   /* Console input vector */
 #define CON_READ    'c'   /* Input character */
 #define CON_WRITE   'o'   /* Write to stdout */
 #define CON_ERROR   'e'   /* Write to stderr */
+#define CON_BUF     'B'   /* Batch buffer address */
+#define CON_CAP     'b'   /* Batch buffer capacity */
 #define SYS_EXIT    'X'   /* Exit code */
 
-static Glyph vm;
-static u8 mem[MEM_SIZE];
+/* Output buffer size: one write(2) per this many bytes */
+#define OUT_SIZE 4096
+
+/* Input block size: one read(2) per this many bytes */
+#define IN_SIZE  0x10000
+
+/* Buffered output device */
+typedef struct {
+    int fd;
+    bool tty;         /* flush on newline */
+    bool unbuffered;  /* flush every byte (-u) */
+    size_t len;
+    u8 buf[OUT_SIZE];
+} ConOut;
+
+/* Block-read input device */
+typedef struct {
+    int fd;
+    size_t pos, len;
+    bool eof;
+    bool in_vector;  /* 'c' holds the event byte, don't pull */
+    u8 buf[IN_SIZE];
+} ConIn;
+
+/* One console machine. Nothing is shared between instances, so a host can
+ * run several at once, each on its own thread. */
+typedef struct {
+    Glyph vm;
+    u8 *mem;
+    u32 mem_size;
+    GlyphOp *code;
+    u32 *stk;        /* call stack, -r frames */
+    ConOut out, err;
+    ConIn in;
+#ifdef GLYPH_JIT
+    GlyphJit jit;
+    bool use_jit;
+#endif
+#ifdef GLYPH_PROFILE
+    GlyphProfile prof;
+#endif
+    GlyphSampler *sampler;  /* -s: guest stacks, or NULL */
+    bool exited;     /* the program wrote 'X' */
+    int exit_code;
+} Console;
+
+static void con_flush(ConOut *o) {
+    size_t done = 0;
+    while (done < o->len) {
+        ssize_t n = write(o->fd, o->buf + done, o->len - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += n;
+    }
+    o->len = 0;
+}
+
+static void con_put(ConOut *o, u8 c) {
+    o->buf[o->len++] = c;
+    if (o->unbuffered || o->len == OUT_SIZE || (o->tty && c == '\n'))
+        con_flush(o);
+}
+
+static void con_flush_all(Console *con) {
+    con_flush(&con->out);
+    con_flush(&con->err);
+}
 
 /* Resonance out: handle port writes */
-static void emu_emit(u8 port) {
+static void emu_emit(Glyph *vm, void *user, u8 port) {
+    Console *con = user;
     switch (port) {
     case CON_WRITE:
-        putchar(vm.port[CON_WRITE] & 0xFF);
-        fflush(stdout);
+        con_put(&con->out, vm->port[CON_WRITE] & 0xFF);
         break;
     case CON_ERROR:
-        fputc(vm.port[CON_ERROR] & 0xFF, stderr);
-        fflush(stderr);
+        con_put(&con->err, vm->port[CON_ERROR] & 0xFF);
         break;
     case SYS_EXIT:
-        exit(vm.port[SYS_EXIT] & 0xFF);
+        con_flush_all(con);
+        con->exited = true;
+        con->exit_code = vm->port[SYS_EXIT] & 0xFF;
+        vm->halt = true;
         break;
     }
 }
 
+/* Refill the input block; false at end of input */
+static bool con_fill(Console *con) {
+    ConIn *in = &con->in;
+    while (in->pos == in->len && !in->eof) {
+        con_flush_all(con);
+        ssize_t n = read(in->fd, in->buf, IN_SIZE);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) in->eof = true;
+        else { in->pos = 0; in->len = n; }
+    }
+    return in->pos < in->len;
+}
+
 /* Resonance in: handle port reads */
-static void emu_sense(u8 port) {
+static void emu_sense(Glyph *vm, void *user, u8 port) {
+    Console *con = user;
     switch (port) {
-    case CON_READ: {
-        int ch = getchar();
-        vm.port[CON_READ] = (ch == EOF) ? 0 : ch;
+    case CON_READ:
+        if (con->in.in_vector) break;
+        con_flush_all(con);
+        vm->port[CON_READ] = con_fill(con) ? con->in.buf[con->in.pos++] : 0;
         break;
     }
+}
+
+/* Run the VM until it halts, sampling its stack if asked */
+static void con_exec(Console *con) {
+    if (con->sampler)
+        glyph_run_sampled(&con->vm, con->sampler, GLYPH_SAMPLE_EVERY);
+    else
+        glyph_run(&con->vm);
+}
+
+/* Call the routine at port['C'] until it returns with ',' */
+static bool call_vector(Console *con) {
+    Glyph *vm = &con->vm;
+    u32 sp = vm->sp;
+    if (sp == vm->depth) {
+        vm->trap = GLYPH_TRAP_OVERFLOW;
+        return false;
+    }
+    vm->stk[vm->sp++] = con->mem_size;  /* returning here runs off memory: halt */
+    vm->reg['.'] = vm->port[CON_VECTOR];
+    vm->halt = false;
+    con_exec(con);
+    vm->sp = sp;
+    return !vm->trap && !con->exited;
+}
+
+/* Copy input into VM memory at addr, wrapping at the end */
+static void copy_in(Console *con, u32 addr, const u8 *src, u32 n) {
+    while (n) {
+        addr &= con->mem_size - 1;
+        u32 run = con->mem_size - addr < n ? con->mem_size - addr : n;
+        memcpy(con->mem + addr, src, run);
+        glyph_touch(&con->vm, addr, run);
+        addr += run; src += run; n -= run;
+    }
+}
+
+/* Step 2 of the input model: feed input to the console vector */
+static void event_loop(Console *con) {
+    Glyph *vm = &con->vm;
+    ConIn *in = &con->in;
+    if (vm->trap || con->exited || !vm->port[CON_VECTOR]) return;
+    in->in_vector = true;
+    while (con_fill(con)) {
+        u32 cap = vm->port[CON_CAP];
+        if (cap) {
+            u32 n = in->len - in->pos;
+            if (n > cap) n = cap;
+            copy_in(con, vm->port[CON_BUF], in->buf + in->pos, n);
+            in->pos += n;
+            vm->port[CON_READ] = n;
+        } else {
+            vm->port[CON_READ] = in->buf[in->pos++];
+        }
+        if (!call_vector(con)) break;
+    }
+}
+
+/* Parse a memory size like 65536, 0x10000, 64K or 16M */
+static u32 parse_size(const char *arg) {
+    char *end;
+    unsigned long long n = strtoull(arg, &end, 0);
+    if (*end == 'K' || *end == 'k') { n <<= 10; end++; }
+    else if (*end == 'M' || *end == 'm') { n <<= 20; end++; }
+    if (*end || n < 256 || n > 0x80000000ull || (n & (n - 1)))
+        return 0;
+    return (u32)n;
+}
+
+/* Set up a console of mem_size bytes and a call stack of depth frames,
+ * talking to the given fds. Memory is reserved with mmap, so pages cost
+ * nothing until touched. */
+static int con_open(Console *con, u32 mem_size, u32 depth, int in_fd,
+                    int out_fd, int err_fd, bool unbuffered) {
+    memset(con, 0, sizeof(*con));
+    con->mem = mmap(NULL, mem_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    con->code = calloc(mem_size, sizeof(GlyphOp));
+    con->stk = calloc(depth, sizeof(u32));
+    if (con->mem == MAP_FAILED || !con->code || !con->stk) {
+        fprintf(stderr, "Error: cannot allocate %u bytes of memory\n", mem_size);
+        if (con->mem != MAP_FAILED) munmap(con->mem, mem_size);
+        free(con->code);
+        free(con->stk);
+        return -1;
+    }
+    con->mem_size = mem_size;
+    con->in.fd = in_fd;
+    con->out = (ConOut){ .fd = out_fd, .tty = isatty(out_fd), .unbuffered = unbuffered };
+    con->err = (ConOut){ .fd = err_fd, .tty = isatty(err_fd), .unbuffered = unbuffered };
+
+    glyph_init(&con->vm, con->mem, mem_size);
+    glyph_stack(&con->vm, con->stk, depth);
+    con->vm.emit = emu_emit;
+    con->vm.sense = emu_sense;
+    con->vm.user = con;
+    return 0;
+}
+
+static void con_close(Console *con) {
+    con_flush_all(con);
+#ifdef GLYPH_JIT
+    glyph_jit_free(&con->vm, &con->jit);
+#endif
+#ifdef GLYPH_PROFILE
+    glyph_profile_free(&con->vm, &con->prof);
+#endif
+    munmap(con->mem, con->mem_size);
+    free(con->code);
+    free(con->stk);
+}
+
+/* Run a loaded program, then its input events; returns the exit code */
+static int con_run(Console *con) {
+    glyph_predecode(&con->vm, con->code);
+#ifdef GLYPH_JIT
+    if (con->use_jit && glyph_jit_init(&con->vm, &con->jit, 1 << 20) < 0)
+        fprintf(stderr, "Warning: JIT unavailable, interpreting\n");
+#endif
+    con_exec(con);
+    event_loop(con);
+    con_flush_all(con);
+    if (con->vm.trap == GLYPH_TRAP_RUNE) {
+        u32 at = (con->vm.reg['.'] - 1) & (con->mem_size - 1);  /* PC moved past it */
+        fprintf(stderr, "Error: unknown rune 0x%02x at 0x%04x\n", con->mem[at], at);
+        return 1;
+    }
+    if (con->vm.trap == GLYPH_TRAP_OVERFLOW) {
+        fprintf(stderr, "Error: call stack overflow at 0x%04x (see -r)\n",
+                con->vm.reg['.']);
+        return 1;
+    }
+    if (con->vm.trap == GLYPH_TRAP_UNDERFLOW) {
+        fprintf(stderr, "Error: return with an empty call stack at 0x%04x\n",
+                con->vm.reg['.']);
+        return 1;
     }
+    return con->exit_code;
 }
 
-/* Load program from file */
-static int load_file(const char *path) {
-    FILE *f = fopen(path, "rb");
-    if (!f) {
+/* Load program from file: map it copy-on-write over the start of memory */
+static int load_file(Console *con, const char *path) {
+    u8 *mem = con->mem;
+    u32 mem_size = con->mem_size;
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
         fprintf(stderr, "Error: cannot open '%s'\n", path);
+        if (fd >= 0) close(fd);
         return -1;
     }
-    size_t n = fread(mem, 1, MEM_SIZE, f);
-    fclose(f);
-    if (n == 0) {
+
+    size_t len = S_ISREG(st.st_mode) ? (size_t)st.st_size : mem_size;
+    if (S_ISREG(st.st_mode) && len > mem_size) {
+        fprintf(stderr, "Warning: '%s' is %zu bytes, only the first %u fit "
+                "in memory (see -m)\n", path, len, mem_size);
+        len = mem_size;
+    }
+
+    if (!S_ISREG(st.st_mode) || len == 0 ||
+        mmap(mem, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+             fd, 0) == MAP_FAILED) {
+        /* Pipes and other unmappable files are read instead */
+        size_t n = 0;
+        ssize_t r;
+        while (n < len && (r = read(fd, mem + n, len - n)) != 0) {
+            if (r < 0 && errno == EINTR) continue;
+            if (r < 0) break;
+            n += r;
+        }
+        len = n;
+    }
+    close(fd);
+
+    if (len == 0) {
         fprintf(stderr, "Error: empty file '%s'\n", path);
         return -1;
     }
@@ -85,53 +368,166 @@ static int load_file(const char *path) {
 }
 
 /* Load program from string */
-static void load_string(const char *code) {
+static void load_string(Console *con, const char *code) {
     size_t len = strlen(code);
-    if (len > MEM_SIZE)
-        len = MEM_SIZE;
-    memcpy(mem, code, len);
+    if (len > con->mem_size)
+        len = con->mem_size;
+    memcpy(con->mem, code, len);
 }
 
 static void usage(const char *prog) {
     fprintf(stderr, "Glyph Console Emulator\n\n");
-    fprintf(stderr, "Usage: %s <program.glyph> [args...]\n", prog);
-    fprintf(stderr, "       %s -e \"<code>\"\n\n", prog);
+    fprintf(stderr, "Usage: %s [options] <program.glyph> [args...]\n", prog);
+    fprintf(stderr, "       %s [options] -e \"<code>\"\n\n", prog);
+    fprintf(stderr, "  -u       unbuffered output (one write per byte)\n");
+#ifdef GLYPH_JIT
+    fprintf(stderr, "  -j       compile hot loops to native code\n");
+#endif
+    fprintf(stderr, "  -m size  memory size, a power of two (default 64K)\n");
+    fprintf(stderr, "  -r depth call stack depth in frames (default 64K)\n");
+#ifdef GLYPH_PROFILE
+    fprintf(stderr, "  -p file  profile: summary to stderr, JSON counters to file\n");
+#endif
+    fprintf(stderr, "  -s file  sample guest stacks, collapsed for flame graphs\n");
+    fprintf(stderr, "  -l map   name sampled frames from a label map\n");
+    fprintf(stderr, "\n");
     fprintf(stderr, "Console Device:\n");
     fprintf(stderr, "  'C' (67)  - vector: input callback address\n");
     fprintf(stderr, "  'c' (99)  - read:   input character\n");
     fprintf(stderr, "  'o' (111) - write:  stdout\n");
     fprintf(stderr, "  'e' (101) - error:  stderr\n");
+    fprintf(stderr, "  'B' (66)  - batch:  input buffer address\n");
+    fprintf(stderr, "  'b' (98)  - batch:  input buffer capacity\n");
     fprintf(stderr, "\nSystem:\n");
     fprintf(stderr, "  'X' (88)  - exit:   exit with code\n");
 }
 
 int main(int argc, char **argv) {
+    static Console con;
+    const char *prog = argv[0];
+    u32 mem_size = MEM_SIZE, depth = STACK_DEPTH;
+    bool unbuffered = false, use_jit = false;
+    const char *prof_path = NULL, *sample_path = NULL, *map_path = NULL;
+    static GlyphSampler sampler;
+
+    /* Options */
+    while (argc > 1) {
+        if (strcmp(argv[1], "-u") == 0) {
+            unbuffered = true;
+        } else if (strcmp(argv[1], "-j") == 0) {
+            use_jit = true;
+        } else if (strcmp(argv[1], "-m") == 0 && argc > 2) {
+            mem_size = parse_size(argv[2]);
+            if (!mem_size) {
+                fprintf(stderr, "Error: -m needs a power of two from 256 to 2G\n");
+                return 1;
+            }
+            argc--; argv++;
+        } else if (strcmp(argv[1], "-r") == 0 && argc > 2) {
+            char *end;
+            unsigned long n = strtoul(argv[2], &end, 0);
+            if (*end == 'K' || *end == 'k') { n <<= 10; end++; }
+            if (*end || !n || n > 0x10000000ul) {
+                fprintf(stderr, "Error: -r needs a depth from 1 to 256M frames\n");
+                return 1;
+            }
+            depth = (u32)n;
+            argc--; argv++;
+        } else if (strcmp(argv[1], "-p") == 0 && argc > 2) {
+            prof_path = argv[2];
+            argc--; argv++;
+        } else if (strcmp(argv[1], "-s") == 0 && argc > 2) {
+            sample_path = argv[2];
+            argc--; argv++;
+        } else if (strcmp(argv[1], "-l") == 0 && argc > 2) {
+            map_path = argv[2];
+            argc--; argv++;
+        } else {
+            break;
+        }
+        argc--; argv++;
+    }
+
     if (argc < 2) {
-        usage(argv[0]);
+        usage(prog);
         return 1;
     }
 
-    /* Initialize VM */
-    glyph_init(&vm, mem, MEM_SIZE);
-    vm.emit = emu_emit;
-    vm.sense = emu_sense;
-
     /* Parse arguments */
-    if (strcmp(argv[1], "-e") == 0) {
-        if (argc < 3) {
-            fprintf(stderr, "Error: -e requires code argument\n");
-            return 1;
-        }
-        load_string(argv[2]);
-    } else if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
-        usage(argv[0]);
+    if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+        usage(prog);
         return 0;
-    } else {
-        if (load_file(argv[1]) < 0)
+    }
+    if (strcmp(argv[1], "-e") == 0 && argc < 3) {
+        fprintf(stderr, "Error: -e requires code argument\n");
+        return 1;
+    }
+
+    /* Initialize VM */
+    if (con_open(&con, mem_size, depth, STDIN_FILENO, STDOUT_FILENO,
+                 STDERR_FILENO, unbuffered) < 0)
+        return 1;
+#ifdef GLYPH_JIT
+    con.use_jit = use_jit;
+#else
+    if (use_jit)
+        fprintf(stderr, "Warning: built without GLYPH_JIT, -j ignored\n");
+#endif
+#ifdef GLYPH_PROFILE
+    if (prof_path && glyph_profile_init(&con.vm, &con.prof) < 0) {
+        fprintf(stderr, "Error: cannot allocate profile counters\n");
+        con_close(&con);
+        return 1;
+    }
+#else
+    if (prof_path)
+        fprintf(stderr, "Warning: built without GLYPH_PROFILE, -p ignored\n");
+#endif
+    if (sample_path) {
+        glyph_sampler_init(&sampler);
+        con.sampler = &sampler;
+    }
+    if (sample_path && map_path) {
+        FILE *map = fopen(map_path, "r");
+        if (!map || glyph_sampler_labels(&sampler, map) < 0) {
+            fprintf(stderr, "Error: cannot read label map '%s'\n", map_path);
+            if (map) fclose(map);
+            con_close(&con);
             return 1;
+        }
+        fclose(map);
     }
 
-    glyph_run(&vm);
+    if (strcmp(argv[1], "-e") == 0) {
+        load_string(&con, argv[2]);
+    } else if (load_file(&con, argv[1]) < 0) {
+        con_close(&con);
+        return 1;
+    }
 
-    return 0;
+    int code = con_run(&con);
+#ifdef GLYPH_PROFILE
+    if (prof_path) {
+        FILE *f = fopen(prof_path, "w");
+        glyph_profile_report(&con.vm, stderr);
+        if (f) {
+            glyph_profile_json(&con.vm, f);
+            fclose(f);
+        } else {
+            fprintf(stderr, "Error: cannot write '%s'\n", prof_path);
+        }
+    }
+#endif
+    if (sample_path) {
+        FILE *f = fopen(sample_path, "w");
+        if (f) {
+            glyph_sampler_write(&sampler, f);
+            fclose(f);
+        } else {
+            fprintf(stderr, "Error: cannot write '%s'\n", sample_path);
+        }
+        glyph_sampler_free(&sampler);
+    }
+    con_close(&con);
+    return code;
 }
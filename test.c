@@ -1,6 +1,9 @@
 /* Glyph VM tests */
 #define GLYPH_IMPL
+#define GLYPH_SAMPLE_IMPL
 #include "glyph.h"
+#include "glyph-sample.h"
+#include "tools/glyphc.h"
 #include <stdio.h>
 
 #define TEST(name) static void test_##name(void)
@@ -9,9 +12,23 @@
 
 static Glyph vm;
 static uint8_t mem[256];
+static GlyphOp code[256];
+static bool predecoded, jitted;
+#ifdef GLYPH_JIT
+static GlyphJit jit;
+#endif
 
-static void run(const char *prog) {
+static void reset(void) {
     glyph_init(&vm, mem, sizeof(mem));
+    if (predecoded) glyph_predecode(&vm, code);
+#ifdef GLYPH_JIT
+    glyph_jit_free(&vm, &jit);
+    if (jitted && glyph_jit_init(&vm, &jit, 0) == 0) jit.hot = 1;
+#endif
+}
+
+static void run(const char *prog) {
+    reset();
     memcpy(mem, prog, strlen(prog) + 1);
     glyph_run(&vm);
 }
@@ -38,17 +55,57 @@ TEST(shifts) {
     ASSERT(vm.reg['d'] == 1);
 }
 
+TEST(immediates) {
+    /* ! takes a literal byte, = a hex digit; shifts use the low 5 bits */
+    run(":0a5 =+baF !-ca\x08 =&da4 !<ea\x21 =>fa2 :'g\x12 =<gg8 !+gg\x34");
+    ASSERT(vm.reg['b'] == 20);
+    ASSERT(vm.reg['c'] == (uint32_t)-3);
+    ASSERT(vm.reg['d'] == 4);
+    ASSERT(vm.reg['e'] == 10);
+    ASSERT(vm.reg['f'] == 1);
+    ASSERT(vm.reg['g'] == 0x1234);
+}
+
 TEST(memory) {
     run(":'a2 :'b* @>ab @<ca");
     ASSERT(vm.reg['c'] == '*');
     ASSERT(mem['2'] == '*');
 }
 
+TEST(wide_memory) {
+    /* Little-endian 16/32-bit loads and stores, wrapping at the end */
+    run(":0v5 ~vv :'a\xfe @Wav @hba @wca :'d\x80 @Hdv @wed");
+    ASSERT(mem[0xFE] == 0xFA && mem[0xFF] == 0xFF && mem[0] == 0xFF && mem[1] == 0xFF);
+    ASSERT(vm.reg['b'] == 0xFFFA);
+    ASSERT(vm.reg['c'] == 0xFFFFFFFA);
+    ASSERT(vm.reg['e'] == 0xFFFA);
+    ASSERT(mem[0x82] == 0);
+}
+
+TEST(bulk) {
+    /* $. copies as if every byte were read first, $= fills, $? compares;
+     * ranges wrap at the end of memory */
+    const char prog[] = ":'s\xf0 :'d\xf2 :0n6 $.dsn $.sdn :'d\xfc :'x* $=dxn "
+                        "$?sdn :.a? $?ssn :.b?";
+    reset();
+    memcpy(mem, prog, sizeof(prog));
+    memcpy(mem + 0xF0, "abcdefghijklmnop", 16);
+    glyph_run(&vm);
+    ASSERT(memcmp(mem + 0xF0, "abcdefefijkl****", 16) == 0);
+    ASSERT(mem[0] == '*' && mem[1] == '*' && mem[2] == 's');
+    ASSERT(vm.reg['a'] == 2);
+    ASSERT(vm.reg['b'] == 1);
+    /* Filled-over code is decoded afresh: +cc1 runs once */
+    run(":011:0k2:044:'x 'L+cc1-kk1?kz:'E0.=E:'d\x12$=dx4..L");
+    ASSERT(vm.reg['c'] == 1);
+    ASSERT(vm.halt && !vm.trap);
+}
+
 TEST(ports) {
     run(":0a5 :'bc #>ab");
     ASSERT(vm.port[5] == 99);
     const char test[] = ":0aa #<ba";
-    glyph_init(&vm, mem, sizeof(mem));
+    reset();
     vm.port[10] = 77;
     memcpy(mem, test, sizeof(test));
     glyph_run(&vm);
@@ -129,6 +186,34 @@ TEST(nested_calls) {
     ASSERT(vm.reg['r'] == 4);  /* G: call F (r=3), r+=1 (r=4) */
 }
 
+TEST(call_stack) {
+    /* F recurses for ever: the call past the last frame traps with PC on
+     * the ;F at byte 7, so a host can hand over a deeper stack and resume */
+    static u32 deep[1024], small[8];
+    run("{F=+aa1;F,}F;F");
+    ASSERT(vm.trap == GLYPH_TRAP_OVERFLOW);
+    ASSERT(vm.reg['a'] == GLYPH_STACK && vm.sp == GLYPH_STACK);
+    ASSERT(vm.reg['.'] == 7 && vm.stk[0] == 14);
+    ASSERT(glyph_stack(&vm, deep, 1024) == 0 && deep[0] == 14);
+    vm.halt = 0; vm.trap = GLYPH_TRAP_NONE;
+    ASSERT(glyph_run_for(&vm, 5000) == GLYPH_TRAPPED);
+    ASSERT(vm.reg['a'] == 1024 && vm.sp == 1024);
+    ASSERT(glyph_stack(&vm, small, 8) < 0 && glyph_stack(&vm, NULL, 0) < 0);
+    /* A snapshot holds that many frames only in a stack of its own */
+    static uint8_t saved[256];
+    static u32 frames[1024];
+    GlyphSnap snap = { .mem = saved };
+    ASSERT(glyph_snapshot(&vm, &snap) < 0);
+    snap.stk = frames;
+    ASSERT(glyph_snapshot(&vm, &snap) == 0 && frames[1023] == 9);
+    vm.sp = 0;
+    ASSERT(glyph_restore(&vm, &snap) == 0 && vm.sp == 1024 && deep[1023] == 9);
+    /* Returning with nothing to return to */
+    run(":0a1 , :0a2");
+    ASSERT(vm.trap == GLYPH_TRAP_UNDERFLOW);
+    ASSERT(vm.reg['a'] == 1 && vm.reg['.'] == 5);
+}
+
 TEST(copy) {
     run(":'a* :.ba");
     ASSERT(vm.reg['b'] == 42);
@@ -140,12 +225,484 @@ TEST(labels) {
     ASSERT(vm.reg['L'] == 2);  /* label captured PC after 'L */
 }
 
-int main(void) {
-    printf("Glyph VM Tests\n==============\n");
+TEST(self_modify) {
+    /* First pass runs :0r1, then @> patches its digit to '7' and loops back */
+    run(":0k7 'L :0r1 ?rk [=E :0pb :'q7 @>pq ..L ]E :0z9");
+    ASSERT(vm.reg['r'] == 7);
+    ASSERT(vm.reg['z'] == 9);
+    ASSERT(mem[11] == '7');
+}
+
+TEST(skip_rewrite) {
+    /* Second pass must see the ]E that @> wrote closer to [=E (bytes 51-52) */
+    run(":011 :0n0 :'p] :'qE :'A3 :'B4 'L +nn1 ?nn [=E :0r1    :0s2 ]E "
+        "?n1 [!X @>Ap @>Bq ..L ]X");
+    ASSERT(vm.reg['n'] == 2);
+    ASSERT(vm.reg['r'] == 0);
+    ASSERT(vm.reg['s'] == 2);
+}
+
+TEST(encoding_table) {
+    /* Every form in glyph-ops.h decodes to its op, as long as it says */
+    static const struct { u8 rune, mode, op; const char *args; } forms[] = {
+#define FORM(r, m, n, ar, t) { r, m, OP_##n, ar },
+        GLYPH_FORMS(FORM)
+#undef FORM
+    };
+    GlyphOp o;
+    for (size_t i = 0; i < sizeof(forms) / sizeof(forms[0]); i++) {
+        reset();
+        memset(mem, 'a', 8);
+        mem[0] = forms[i].rune;
+        if (forms[i].mode) mem[1] = forms[i].mode;
+        glyph_decode_at(&vm, 0, &o);
+        ASSERT(o.op == forms[i].op);
+        ASSERT(o.len == 1 + !!forms[i].mode + strlen(forms[i].args));
+    }
+    /* Operands land in a, b, c; literals always in c */
+    reset();
+    memcpy(mem, ":'kX", 4);
+    glyph_decode_at(&vm, 0, &o);
+    ASSERT(o.a == 'k' && o.c == 'X');
+    memcpy(mem, ".?z", 3);
+    glyph_decode_at(&vm, 0, &o);
+    ASSERT(o.op == OP_NOP && o.len == 3);
+}
+
+TEST(run_for) {
+    /* Time-sliced run must end in the same state as one glyph_run */
+    const char prog[] = ":0c9 :011 'L -cc1 ?cz .!L :0r1";
+    int slices = 0;
+    GlyphStatus st;
+    reset();
+    memcpy(mem, prog, sizeof(prog));
+    ASSERT(glyph_run_for(&vm, 0) == GLYPH_BUDGET);
+    while ((st = glyph_run_for(&vm, 3)) == GLYPH_BUDGET) slices++;
+    ASSERT(st == GLYPH_HALTED);
+    ASSERT(slices > 10);
+    ASSERT(vm.reg['c'] == 0);
+    ASSERT(vm.reg['r'] == 1);
+    u64 steps = vm.steps;
+    run(prog);
+    ASSERT(vm.steps == steps);
+    ASSERT(vm.reg['r'] == 1);
+}
+
+TEST(trap) {
+    run(":0a1 Z :0a2");
+    ASSERT(vm.trap == GLYPH_TRAP_RUNE);
+    ASSERT(vm.reg['a'] == 1);
+    ASSERT(glyph_run_for(&vm, 10) == GLYPH_TRAPPED);
+    run(":0a1");
+    ASSERT(vm.trap == GLYPH_TRAP_NONE);
+    ASSERT(glyph_run_for(&vm, 10) == GLYPH_HALTED);
+}
+
+TEST(end_of_memory) {
+    /* A rune cut off by the end of memory reads zeros and halts */
+    reset();
+    memset(mem, ' ', sizeof(mem));
+    memcpy(mem + sizeof(mem) - 2, "+a", 2);
+    vm.reg[0] = 3;
+    glyph_run(&vm);
+    ASSERT(vm.halt);
+    ASSERT(vm.reg['a'] == 6);
+    ASSERT(vm.reg['.'] == sizeof(mem));
+}
+
+TEST(snapshot) {
+    /* Boot, snapshot, then serve from the same state each time. With 'b'
+     * set the program patches its own :0r1, so a restore must also roll
+     * back the decoded rune. */
+    const char prog[] = ":0a5 ?bz [=S :'p\" :'q9 @>pq ]S :0r1 +rra";
+    static uint8_t saved[256];
+    static u32 dirty[GLYPH_DIRTY_WORDS(256)];
+    GlyphSnap snap = { .mem = saved };
+    reset();
+    memcpy(mem, prog, sizeof(prog));
+    glyph_track(&vm, dirty);
+    ASSERT(glyph_run_for(&vm, 1) == GLYPH_BUDGET);
+    ASSERT(glyph_snapshot(&vm, &snap) == 0);
+    for (int i = 0; i < 2; i++) {
+        ASSERT(glyph_restore(&vm, &snap) == 0);
+        ASSERT(vm.reg['a'] == 5 && vm.reg['.'] == 4 && vm.steps == 1);
+        ASSERT(mem[34] == '1');
+        vm.reg['b'] = 1;
+        glyph_run(&vm);
+        ASSERT(vm.reg['r'] == 14);
+        ASSERT(dirty[0] == 1);
+    }
+    glyph_restore(&vm, &snap);
+    ASSERT(dirty[0] == 0);
+    glyph_run(&vm);
+    ASSERT(vm.reg['r'] == 6);
+    ASSERT(vm.reg['b'] == 0);
+
+    /* Retaking the snapshot stales every other VM based on it */
+    static uint8_t mem2[256];
+    static u32 dirty2[GLYPH_DIRTY_WORDS(256)];
+    Glyph other;
+    glyph_init(&other, mem2, sizeof(mem2));
+    glyph_track(&other, dirty2);
+    ASSERT(glyph_restore(&other, &snap) == 0 && mem2[34] == '1');
+    glyph_restore(&vm, &snap);
+    mem[200] = 'X';
+    glyph_touch(&vm, 200, 1);
+    ASSERT(glyph_snapshot(&vm, &snap) == 0);
+    ASSERT(glyph_restore(&other, &snap) == 0 && mem2[200] == 'X');
+}
+
+TEST(patch_hot_loop) {
+    /* The second pass rewrites :0r1 (byte 36) inside the loop body, which a
+     * JIT has compiled by then; the third pass must see :0r5 */
+    run(":011 :0k3 :0s0 :0t2 :'p$ :'q5 'L :0r1 +ssr ?kt [!N @>pq ]N -kk1 ?kz .!L");
+    ASSERT(mem[36] == '5');
+    ASSERT(vm.reg['s'] == 7);
+}
+
+TEST(fused_lits) {
+    /* A G_LOAD16 into one register fuses into a single LITS slot */
+    run(":0b1 =<bb8 !+bb\x80");
+    ASSERT(vm.reg['b'] == 0x180);
+#ifndef GLYPH_PROFILE
+    if (predecoded) ASSERT(code[0].op == OP_LITS && code[0].len == 16);
+#endif
+}
+
+TEST(jit_targets) {
+    /* Only the backward leap to L and the calls to F count; L starts a
+     * one-rune run and is marked cold, E (byte 50) is only reached forward */
+    run(":011 {F +aa1 +aa1 , }F :0k3 :'E2 'L?kz.=E;F-kk1.!L:0r1");
+    ASSERT(vm.reg['a'] == 6 && vm.reg['r'] == 1);
+#ifdef GLYPH_JIT
+    if (!jitted) return;
+    ASSERT(jit.entry[vm.reg['F']] != 0);
+    ASSERT(jit.heat[vm.reg['L']] == GLYPH_JIT_COLD && !jit.entry[vm.reg['L']]);
+    ASSERT(jit.heat[vm.reg['E']] == 0);
+#endif
+}
+
+TEST(fused_patch) {
+    /* :0a3 +aaa at byte 33 fuses into one slot; the second pass rewrites
+     * the + five bytes in, past the usual 3-byte lookbehind */
+    run(":011 :0k3 :0s0 :0t2 :'p& :'q* 'L :0a3 +aaa +ssa ?kt [!N @>pq ]N "
+        "-kk1 ?kz .!L");
+    ASSERT(vm.reg['s'] == 6 + 6 + 9);
+    ASSERT(vm.steps == 66);
+#ifdef GLYPH_PROFILE
+    (void)jitted;  /* profiling builds never fuse */
+#else
+    if (predecoded && !jitted) ASSERT(code[33].len > 4);
+#endif
+}
+
+#ifdef GLYPH_PROFILE
+TEST(profile) {
+    /* F at byte 7 is called three times; both engines count the same */
+    const char *prog = ":011 {F +aa1 , }F :0k3 'L ;F -kk1 ?kz .!L :'pc #>pa";
+    static GlyphProfile prof;
+    reset();
+    ASSERT(glyph_profile_init(&vm, &prof) == 0);
+    memcpy(mem, prog, strlen(prog) + 1);
+    glyph_run(&vm);
+    ASSERT(vm.reg['a'] == 3);
+    ASSERT(prof.op['+'] == 3 && prof.op[';'] == 3 && prof.op['?'] == 3);
+    ASSERT(prof.pc[8] == 3 && prof.pc[0] == 1);
+    ASSERT(prof.call[7] == 3);
+    ASSERT(prof.skips == 1 && prof.scans == 1 && prof.scanned == 8);
+    ASSERT(prof.scan_len[4] == 1);
+    ASSERT(prof.out['c'] == 1 && prof.in['c'] == 0);
+    u64 runes = 0;
+    for (int i = 0; i < 256; i++) runes += prof.op[i];
+    ASSERT(runes == vm.steps);
+    glyph_profile_free(&vm, &prof);
+    ASSERT(vm.prof == NULL);
+}
+#endif
+
+static u32 rng_state = 12345;
+
+static u32 rng(u32 n) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state % n;
+}
+
+/* Random loop body: ALU, immediates, loads, compares, marks, the odd store
+ * or PC write */
+static size_t random_prog(char *p) {
+    static const char *alu = "+-*/%&|^<>", *dst = "abcdef?", *src = "abcdef?.k1z";
+    char *s = p + sprintf(p, ":011 :0k9 'L ");
+    for (int i = 0; i < 14; i++) {
+        char d = dst[rng(7)], x = src[rng(11)], y = src[rng(11)];
+        switch (rng(10)) {
+        case 0: case 1:
+            s += sprintf(s, "%c%c%c%c ", alu[rng(10)], d, x, y); break;
+        case 2:
+            if (rng(2)) s += sprintf(s, "=%c%c%c%x ", "+-&<>"[rng(5)], d, x, rng(16));
+            else s += sprintf(s, "!%c%c%c%c ", "+-&<>"[rng(5)], d, x, 33 + rng(94));
+            break;
+        case 3: s += sprintf(s, "~%c%c ", d, x); break;
+        case 4: s += sprintf(s, ":.%c%c ", d, x); break;
+        case 5: s += sprintf(s, ":0%c%x ", d, rng(16)); break;
+        case 6: s += sprintf(s, "@<%c%c ", d, x); break;
+        case 7: s += sprintf(s, "?%c%c ", x, y); break;
+        case 8: s += sprintf(s, "'%c ", d); break;
+        case 9: s += sprintf(s, rng(4) ? "  " : rng(2) ? "@>%c%c " : ":..%c ", x, y); break;
+        }
+    }
+    s += sprintf(s, "-kk1 ?kz .!L");
+    return s - p + 1;
+}
+
+/* Run prog under this pass's engine and the reference stepper from the
+ * same registers; true if both end in the same state */
+static bool same_as_reference(const char *prog, size_t len, const u32 *seed) {
+    static uint8_t ref_mem[256];
+    Glyph ref;
+    glyph_init(&ref, ref_mem, sizeof(ref_mem));
+    memset(ref_mem, 0, sizeof(ref_mem));
+    memcpy(ref_mem, prog, len);
+    reset();
+    memset(mem, 0, sizeof(mem));
+    memcpy(mem, prog, len);
+    for (int i = 0; i < 6; i++) ref.reg['a' + i] = vm.reg['a' + i] = seed[i];
+    GlyphStatus st = glyph_run_for(&ref, 3000);
+    return glyph_run_for(&vm, 3000) == st &&
+           vm.steps == ref.steps &&
+           memcmp(vm.reg, ref.reg, sizeof(vm.reg)) == 0 &&
+           memcmp(mem, ref_mem, sizeof(mem)) == 0 &&
+           memcmp(vm.port, ref.port, sizeof(vm.port)) == 0 &&
+           vm.sp == ref.sp && vm.trap == ref.trap;
+}
+
+TEST(differential) {
+    /* Every engine must end in the same state as the reference stepper */
+    char prog[256];
+    for (int n = 0; n < 300; n++) {
+        size_t len = random_prog(prog);
+        u32 seed[6];
+        for (int i = 0; i < 6; i++) seed[i] = rng(1000) * rng(5000);
+        ASSERT(same_as_reference(prog, len, seed));
+    }
+}
+
+TEST(fuzz_regressions) {
+    /* Shrunk glyph-fuzz findings */
+    static const char *found[] = {
+        ":0.7:'",                            /* :0.x fused with a literal after it */
+        " :0kb 'L ~?d *k1F @<LF :'b ?b..!",  /* ?b. fused with its leap read PC late */
+        ":0a1 :'b\xFF",                     /* fusing read val[0xFF] (ASan) */
+    };
+    static const u32 zero[6];
+    for (size_t i = 0; i < sizeof(found) / sizeof(found[0]); i++)
+        ASSERT(same_as_reference(found[i], strlen(found[i]), zero));
+}
+
+/* Assemble gen, optimized or not, and run it in a VM of its own */
+static bool run_asm(Glyph *v, void (*gen)(GlyphAsm *), bool opt) {
+    static uint8_t big[2][4096];
+    GlyphAsm g;
+    glyph_init_asm(&g, NULL, 0);
+    gen(&g);
+    if ((opt && glyph_optimize(&g, NULL) < 0) || glyph_resolve(&g) < 0 ||
+        g.pos > sizeof(big[0])) {
+        glyph_free_asm(&g);
+        return false;
+    }
+    memset(big[opt], 0, sizeof(big[0]));
+    memcpy(big[opt], g.buf, g.pos);
+    glyph_free_asm(&g);
+    glyph_init(v, big[opt], sizeof(big[0]));
+    return glyph_run_for(v, 100000) == GLYPH_HALTED;
+}
+
+/* Registers and ports match, bar the PC, the scratch registers the
+ * optimizer may drop and j, which holds label addresses that move */
+static bool same_as_unoptimized(void (*gen)(GlyphAsm *)) {
+    static Glyph plain, opt;
+    if (!run_asm(&plain, gen, false) || !run_asm(&opt, gen, true)) return false;
+    for (int i = 0; i < 128; i++)
+        if (!strchr(".?~_j", i) && plain.reg[i] != opt.reg[i]) return false;
+    return memcmp(plain.port, opt.port, sizeof(plain.port)) == 0;
+}
+
+static void emit_runes(GlyphAsm *g, const char *s) {
+    while (*s) G_EMIT(g, *s++);
+}
+
+/* The compare feeds a skip: equal, so :0r7 never runs */
+static void gen_cmp_skip(GlyphAsm *g) {
+    G_LOAD_HEX(g, 'a', 1);
+    G_LOAD_HEX(g, 'b', 1);
+    G_CMP(g, 'a', 'b');
+    emit_runes(g, "[=E");
+    G_LOAD_HEX(g, 'r', 7);
+    emit_runes(g, "]E");
+    G_LOAD_LIT(g, 'o', 'o');
+    G_WRITE_PORT(g, 'o', 'r');
+    G_EMIT(g, 0);
+}
+
+/* The compare feeds a leap over :0r7, across a label and dead stores */
+static void gen_cmp_leap(GlyphAsm *g) {
+    G_LOAD_HEX(g, 'a', 3);
+    G_LOAD_HEX(g, 'b', 5);
+    G_LOAD16_LABEL(g, 'j', "over");
+    G_CMP(g, 'a', 'b');
+    G_LEAP(g, '<', 'j');
+    G_LOAD_HEX(g, 'r', 7);
+    G_LABEL(g, "over");
+    G_LOAD_HEX(g, 's', 1);
+    G_LOAD_HEX(g, 's', 2);
+    G_LOAD_LIT(g, 'o', 'o');
+    G_WRITE_PORT(g, 'o', 'r');
+    G_EMIT(g, 0);
+}
+
+/* Immediates of every size, folded constants and a label past 255 that
+ * glyph_relax has to keep long */
+static void gen_imm_relax(GlyphAsm *g) {
+    static const uint32_t vals[] = { 0, 9, 0x41, 0xFF, 0x100, 0x1234, 0xFFFF,
+                                     0x10000, 0xDEADBEEF, 0xFFFFFFFF };
+    for (int i = 0; i < 10; i++) G_LOAD_IMM(g, 'A' + i, vals[i]);
+    G_CONST(g, 'z', 0);
+    G_ADDI(g, 'k', 'z', 200);
+    G_SHLI(g, 'k', 'k', 4);
+    G_SUBI(g, 'k', 'k', 3);
+    G_LOAD16_LABEL(g, 'j', "far");
+    G_JUMP(g, 'j');
+    for (int i = 0; i < 300; i++) G_DATA(g, 0);
+    G_LABEL(g, "far");
+    G_LOAD_LIT(g, 'o', 'o');
+    G_WRITE_PORT(g, 'o', 'k');
+    G_EMIT(g, 0);
+}
+
+TEST(assembler) {
+    /* The optimizer must not change what a program does */
+    ASSERT(same_as_unoptimized(gen_cmp_skip));
+    ASSERT(same_as_unoptimized(gen_cmp_leap));
+    ASSERT(same_as_unoptimized(gen_imm_relax));
+    static Glyph v;
+    ASSERT(run_asm(&v, gen_cmp_skip, true) && v.reg['r'] == 0);
+    ASSERT(run_asm(&v, gen_cmp_leap, true) && v.reg['r'] == 0 && v.reg['s'] == 2);
+    ASSERT(run_asm(&v, gen_imm_relax, true));
+    ASSERT(v.reg['A'] == 0 && v.reg['C'] == 0x41 && v.reg['G'] == 0xFFFF);
+    ASSERT(v.reg['I'] == 0xDEADBEEF && v.reg['J'] == 0xFFFFFFFF);
+    ASSERT(v.port['o'] == 200 * 16 - 3);
+}
+
+static void sum_emit(Glyph *g, void *user, u8 port) {
+    *(u32 *)user += g->port[port];
+}
+
+TEST(resonance_user) {
+    /* Two VMs, each reporting to its own host context */
+    const char prog[] = ":0a1 :0b5 #>ab #>ab";
+    static uint8_t mem2[256];
+    Glyph other;
+    u32 sum = 0, sum2 = 0;
+    reset();
+    memcpy(mem, prog, sizeof(prog));
+    vm.emit = sum_emit;
+    vm.user = &sum;
+    glyph_init(&other, mem2, sizeof(mem2));
+    memcpy(mem2, prog, sizeof(prog));
+    other.emit = sum_emit;
+    other.user = &sum2;
+    ASSERT(glyph_run_for(&vm, 3) == GLYPH_BUDGET);
+    glyph_run(&other);
+    glyph_run(&vm);
+    ASSERT(sum == 10);
+    ASSERT(sum2 == 10);
+    ASSERT(vm.port[1] == 5);
+}
+
+typedef struct { char text[64]; size_t len; } Console;
+
+static void console_emit(Glyph *g, void *user, u8 port) {
+    Console *c = user;
+    if (port == 'o' && c->len < sizeof(c->text) - 1)
+        c->text[c->len++] = (char)g->port[port];
+}
+
+TEST(hello_example) {
+    /* The documented example prints its greeting (run from the repo root) */
+    Console out = { .len = 0 };
+    FILE *f = fopen("examples/hello.glyph", "rb");
+    ASSERT(f);
+    reset();
+    memset(mem, 0, sizeof(mem));
+    size_t n = fread(mem, 1, sizeof(mem), f);
+    fclose(f);
+    ASSERT(n > 0 && n < sizeof(mem));
+    vm.emit = console_emit;
+    vm.user = &out;
+    glyph_run(&vm);
+    ASSERT(!vm.trap && !strcmp(out.text, "Hello, World!\n"));
+}
+
+TEST(sampler) {
+    /* main calls F, F calls G twice; every stack is rooted in main */
+    const char *prog = ":011 :0kf *kkk {G +bb1 , }G {F +aa1 ;G ;G , }F "
+                       "'L ;F -kk1 ?kz .!L";
+    static GlyphSampler s;
+    char line[128];
+    u64 total = 0;
+    bool deep = false;
+    FILE *f = tmpfile();
+    ASSERT(f);
+    fputs(";   G    = 0x0011\n;   F    = 0x001e\n; Size: 3 bytes\n"
+          ";   main = 0x002f\n", f);
+    rewind(f);
+    glyph_sampler_init(&s);
+    ASSERT(glyph_sampler_labels(&s, f) == 3);
+    reset();
+    memcpy(mem, prog, strlen(prog) + 1);
+    ASSERT(glyph_run_sampled(&vm, &s, 20) == GLYPH_HALTED);
+    ASSERT(vm.reg['a'] == 15 * 15);
+    ASSERT(s.samples > 100 && !s.dropped);
+
+    rewind(f);
+    glyph_sampler_write(&s, f);
+    rewind(f);
+    for (u32 i = 0; i < s.stacks; i++) {
+        unsigned long long n;
+        ASSERT(fgets(line, sizeof(line), f));
+        ASSERT(!strncmp(line, "main", 4) || !strncmp(line, "0x", 2));
+        ASSERT(sscanf(strrchr(line, ' '), "%llu", &n) == 1);
+        deep |= !strncmp(line, "main;F;G ", 9);
+        total += n;
+    }
+    fclose(f);
+    ASSERT(deep);
+    ASSERT(total == s.samples);
+    glyph_sampler_free(&s);
+
+    /* Recursion deeper than a sample holds keeps the innermost frames */
+    static u32 stk[2048];
+    glyph_sampler_init(&s);
+    reset();
+    ASSERT(glyph_stack(&vm, stk, 2048) == 0);
+    memcpy(mem, "'a;a", 5);
+    ASSERT(glyph_run_sampled(&vm, &s, 20) == GLYPH_TRAPPED);
+    ASSERT(vm.trap == GLYPH_TRAP_OVERFLOW);
+    ASSERT(s.truncated > 50 && !s.dropped);
+    for (u32 i = 0; i < s.cap; i++)
+        ASSERT(s.table[i].len <= GLYPH_SAMPLE_DEPTH + 1);
+    glyph_sampler_free(&s);
+}
+
+static void suite(void) {
     RUN(arithmetic);
     RUN(bitwise);
     RUN(shifts);
+    RUN(immediates);
     RUN(memory);
+    RUN(wide_memory);
+    RUN(bulk);
     RUN(ports);
     RUN(jump);
     RUN(jump_then_execute);
@@ -156,8 +713,45 @@ int main(void) {
     RUN(conditional_lt);
     RUN(call_return);
     RUN(nested_calls);
+    RUN(call_stack);
     RUN(copy);
     RUN(labels);
+    RUN(self_modify);
+    RUN(skip_rewrite);
+    RUN(encoding_table);
+    RUN(run_for);
+    RUN(trap);
+    RUN(end_of_memory);
+    RUN(resonance_user);
+    RUN(hello_example);
+    RUN(snapshot);
+    RUN(patch_hot_loop);
+    RUN(fused_lits);
+    RUN(jit_targets);
+    RUN(fused_patch);
+    RUN(differential);
+    RUN(fuzz_regressions);
+    RUN(assembler);
+    RUN(sampler);
+#ifdef GLYPH_PROFILE
+    RUN(profile);
+#endif
+}
+
+int main(void) {
+    printf("Glyph VM Tests\n==============\n");
+    suite();
+    printf("-- predecoded --\n");
+    predecoded = true;
+    suite();
+#ifdef GLYPH_JIT
+    reset();
+    if (glyph_jit_init(&vm, &jit, 0) == 0) {
+        printf("-- jit --\n");
+        jitted = true;
+        suite();
+    }
+#endif
     printf("==============\nAll tests passed.\n");
     return 0;
 }
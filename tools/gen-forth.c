@@ -2,11 +2,11 @@
  * gen-forth.c - Generate a minimal Forth interpreter in Glyph
  * 
  * Memory Map:
- *   0x0100 - 0x0FFF  Code (interpreter + primitives)
+ *   0x0000 - 0x0FFF  Code (interpreter + primitives)
  *   0x1000 - 0x10FF  Input buffer (256 bytes)
  *   0x1100 - 0x11FF  Word buffer (256 bytes) 
- *   0x1200 - 0x12FF  Parameter stack (256 bytes, grows down)
- *   0x1300 - 0x13FF  Return stack (256 bytes, grows down)
+ *   0x1200 - 0x12FF  Parameter stack (64 cells, grows down)
+ *   0x1300 - 0x13FF  Return stack (64 cells, grows down)
  *   0x1400 - 0x7FFF  Dictionary + user definitions
  *   0x8000 - 0xFFFF  Free memory (HERE starts here)
  *
@@ -18,11 +18,9 @@
  *   I  - Instruction pointer (for threaded code)
  *   T  - Top of stack cache
  *   N  - Next on stack
+ *   E  - Exit address (BYE, for EOF)
  *   
- *   z  - Zero constant
- *   1  - One constant  
- *   4  - Four constant
- *   8  - Eight constant
+ *   z  - Zero constant (steps and masks are immediates)
  *   
  *   i  - Input port ('c')
  *   o  - Output port ('o')
@@ -36,52 +34,54 @@
  *   - len: name length (1-31)
  *   - name: the word name
  *   - code: native Glyph code or threaded addresses
+ *
+ * Cells are 32 bits, little endian, and move with @w/@W in one rune.
  */
 
 #include "glyphc.h"
 #include <string.h>
 
-static uint8_t buffer[8192];
 static GlyphAsm g;
 
 /* Memory layout constants */
 #define INPUT_BUF   0x1000
 #define WORD_BUF    0x1100
-#define PSTACK      0x12FF   /* Stack grows down */
-#define RSTACK      0x13FF   /* Return stack grows down */
+#define PSTACK      0x12FC   /* Stack grows down, a cell at a time */
+#define RSTACK      0x13FC   /* Return stack grows down */
 #define DICT_START  0x1400
 #define HERE_START  0x8000
 
 /* Current dictionary pointer for building */
 static uint16_t dict_here = DICT_START;
-static uint16_t last_word = 0;
+static char last_word[64];    /* Label of the latest entry, "" = none */
 
 /* ─────────────────────────────────────────────────────────────────────────
  * Helper: Define a dictionary entry header
  * ───────────────────────────────────────────────────────────────────────── */
 static void dict_header(const char *name, int flags) {
-    /* Remember this entry's address */
-    uint16_t entry_addr = G_HERE(&g);
-    
     /* Create label for this word */
     char label[64];
     snprintf(label, sizeof(label), "word_%s", name);
     G_LABEL(&g, label);
     
     /* Link to previous word (2 bytes, little endian) */
-    G_EMIT(&g, last_word & 0xFF);
-    G_EMIT(&g, (last_word >> 8) & 0xFF);
+    if (last_word[0]) {
+        G_DATA16_LABEL(&g, last_word);
+    } else {
+        G_DATA(&g, 0);
+        G_DATA(&g, 0);
+    }
     
     /* Flags + length */
     int len = strlen(name);
-    G_EMIT(&g, flags | (len & 0x1F));
+    G_DATA(&g, flags | (len & 0x1F));
     
     /* Name */
     for (int i = 0; i < len; i++) {
-        G_EMIT(&g, name[i]);
+        G_DATA(&g, name[i]);
     }
     
-    last_word = entry_addr;
+    strcpy(last_word, label);
 }
 
 /* ─────────────────────────────────────────────────────────────────────────
@@ -90,24 +90,26 @@ static void dict_header(const char *name, int flags) {
 
 /* Push T onto stack, load new value into T */
 static void emit_push(void) {
-    /* mem[S] = T; S-- */
-    G_STORE_MEM(&g, 'S', 'T');
-    G_SUB(&g, 'S', 'S', '1');
+    /* mem[S] = T; S -= 4 */
+    G_STORE32_MEM(&g, 'S', 'T');
+    G_SUBI(&g, 'S', 'S', 4);
 }
 
 /* Pop from stack into T */
 static void emit_pop(void) {
-    /* S++; T = mem[S] */
-    G_ADD(&g, 'S', 'S', '1');
-    G_LOAD_MEM(&g, 'T', 'S');
+    /* S += 4; T = mem[S] */
+    G_ADDI(&g, 'S', 'S', 4);
+    G_LOAD32_MEM(&g, 'T', 'S');
 }
 
 /* ─────────────────────────────────────────────────────────────────────────
  * Main generator
  * ───────────────────────────────────────────────────────────────────────── */
 
-int main(void) {
-    glyph_init_asm(&g, buffer, sizeof(buffer));
+int main(int argc, char **argv) {
+    int optimize = !(argc > 1 && strcmp(argv[1], "-O0") == 0);
+    GlyphOptStats opt = { 0, 0, 0, 0 };
+    glyph_init_asm(&g, NULL, 0);
     
     /* ═══════════════════════════════════════════════════════════════════════
      * INITIALIZATION
@@ -116,10 +118,7 @@ int main(void) {
     G_LABEL(&g, "init");
     
     /* Constants */
-    G_LOAD_HEX(&g, 'z', 0);
-    G_LOAD_HEX(&g, '1', 1);
-    G_LOAD_HEX(&g, '4', 4);
-    G_LOAD_HEX(&g, '8', 8);
+    G_CONST(&g, 'z', 0);         /* Compares and stores take registers */
     
     /* I/O ports */
     G_LOAD_LIT(&g, 'i', 'c');    /* stdin */
@@ -129,9 +128,10 @@ int main(void) {
     G_LOAD16(&g, 'S', PSTACK);   /* Parameter stack */
     G_LOAD16(&g, 'R', RSTACK);   /* Return stack */
     G_LOAD16(&g, 'H', HERE_START); /* HERE */
+    G_LOAD16_LABEL(&g, 'E', "prim_bye");
     
     /* Clear TOS */
-    G_COPY(&g, 'T', 'z');
+    G_LOAD_HEX(&g, 'T', 0);
     
     /* Print prompt and enter main loop */
     G_LOAD_LIT(&g, 'a', '>');
@@ -189,11 +189,11 @@ int main(void) {
     
     dict_header("SWAP", 0);
     G_LABEL(&g, "prim_swap");
-    /* N = mem[S+1] */
-    G_ADD(&g, 'a', 'S', '1');
-    G_LOAD_MEM(&g, 'N', 'a');
-    /* mem[S+1] = T */
-    G_STORE_MEM(&g, 'a', 'T');
+    /* N = mem[S+4] */
+    G_ADDI(&g, 'a', 'S', 4);
+    G_LOAD32_MEM(&g, 'N', 'a');
+    /* mem[S+4] = T */
+    G_STORE32_MEM(&g, 'a', 'T');
     /* T = N */
     G_COPY(&g, 'T', 'N');
     G_RET(&g);
@@ -205,10 +205,9 @@ int main(void) {
     dict_header("OVER", 0);
     G_LABEL(&g, "prim_over");
     emit_push();
-    /* T = mem[S+2] */
-    G_ADD(&g, 'a', 'S', '1');
-    G_ADD(&g, 'a', 'a', '1');
-    G_LOAD_MEM(&g, 'T', 'a');
+    /* T = mem[S+8] */
+    G_ADDI(&g, 'a', 'S', 8);
+    G_LOAD32_MEM(&g, 'T', 'a');
     G_RET(&g);
     
     /* ═══════════════════════════════════════════════════════════════════════
@@ -218,8 +217,8 @@ int main(void) {
     dict_header("+", 0);
     G_LABEL(&g, "prim_add");
     /* N = pop */
-    G_ADD(&g, 'S', 'S', '1');
-    G_LOAD_MEM(&g, 'N', 'S');
+    G_ADDI(&g, 'S', 'S', 4);
+    G_LOAD32_MEM(&g, 'N', 'S');
     /* T = N + T */
     G_ADD(&g, 'T', 'N', 'T');
     G_RET(&g);
@@ -230,8 +229,8 @@ int main(void) {
     
     dict_header("-", 0);
     G_LABEL(&g, "prim_sub");
-    G_ADD(&g, 'S', 'S', '1');
-    G_LOAD_MEM(&g, 'N', 'S');
+    G_ADDI(&g, 'S', 'S', 4);
+    G_LOAD32_MEM(&g, 'N', 'S');
     G_SUB(&g, 'T', 'N', 'T');
     G_RET(&g);
     
@@ -241,8 +240,8 @@ int main(void) {
     
     dict_header("*", 0);
     G_LABEL(&g, "prim_mul");
-    G_ADD(&g, 'S', 'S', '1');
-    G_LOAD_MEM(&g, 'N', 'S');
+    G_ADDI(&g, 'S', 'S', 4);
+    G_LOAD32_MEM(&g, 'N', 'S');
     G_MUL(&g, 'T', 'N', 'T');
     G_RET(&g);
     
@@ -252,8 +251,8 @@ int main(void) {
     
     dict_header("/", 0);
     G_LABEL(&g, "prim_div");
-    G_ADD(&g, 'S', 'S', '1');
-    G_LOAD_MEM(&g, 'N', 'S');
+    G_ADDI(&g, 'S', 'S', 4);
+    G_LOAD32_MEM(&g, 'N', 'S');
     G_DIV(&g, 'T', 'N', 'T');
     G_RET(&g);
     
@@ -263,8 +262,8 @@ int main(void) {
     
     dict_header("MOD", 0);
     G_LABEL(&g, "prim_mod");
-    G_ADD(&g, 'S', 'S', '1');
-    G_LOAD_MEM(&g, 'N', 'S');
+    G_ADDI(&g, 'S', 'S', 4);
+    G_LOAD32_MEM(&g, 'N', 'S');
     G_MOD(&g, 'T', 'N', 'T');
     G_RET(&g);
     
@@ -298,27 +297,26 @@ int main(void) {
     G_DIV(&g, 'T', 'T', 'f');     /* T = T / 10 */
     
     /* Convert to ASCII and store in buffer */
-    G_LOAD_LIT(&g, 'n', '0');
-    G_ADD(&g, 'a', 'a', 'n');     /* a = digit char */
+    G_ADDI(&g, 'a', 'a', '0');    /* a = digit char */
     G_STORE_MEM(&g, 'x', 'a');    /* store at x */
-    G_SUB(&g, 'x', 'x', '1');     /* x-- (buffer grows down) */
+    G_SUBI(&g, 'x', 'x', 1);      /* x-- (buffer grows down) */
     
     G_LOAD16_LABEL(&g, 'b', "dot_loop");
     G_JUMP(&g, 'b');
     
     G_LABEL(&g, "dot_print");
     /* Print digits from x+1 to 0x10FF */
-    G_ADD(&g, 'x', 'x', '1');     /* x points to first digit */
+    G_ADDI(&g, 'x', 'x', 1);      /* x points to first digit */
     
     G_LABEL(&g, "dot_print_loop");
     G_LOAD16(&g, 'n', 0x10FF);
-    G_ADD(&g, 'n', 'n', '1');     /* n = 0x1100 (one past end) */
+    G_ADDI(&g, 'n', 'n', 1);      /* n = 0x1100 (one past end) */
     G_LOAD16_LABEL(&g, 'b', "dot_done");
     G_JEQ(&g, 'x', 'n', 'b');     /* x == 0x1100? Done */
     
     G_LOAD_MEM(&g, 'a', 'x');     /* a = digit char */
     G_WRITE_PORT(&g, 'o', 'a');   /* print it */
-    G_ADD(&g, 'x', 'x', '1');     /* x++ */
+    G_ADDI(&g, 'x', 'x', 1);      /* x++ */
     G_LOAD16_LABEL(&g, 'b', "dot_print_loop");
     G_JUMP(&g, 'b');
     
@@ -357,15 +355,15 @@ int main(void) {
     
     dict_header("=", 0);
     G_LABEL(&g, "prim_eq");
-    G_ADD(&g, 'S', 'S', '1');
-    G_LOAD_MEM(&g, 'N', 'S');
+    G_ADDI(&g, 'S', 'S', 4);
+    G_LOAD32_MEM(&g, 'N', 'S');
     /* If N == T, result is 1, else 0 */
     G_LOAD16_LABEL(&g, 'a', "eq_true");
     G_JEQ(&g, 'N', 'T', 'a');
-    G_COPY(&g, 'T', 'z');  /* false */
+    G_LOAD_HEX(&g, 'T', 0);  /* false */
     G_RET(&g);
     G_LABEL(&g, "eq_true");
-    G_COPY(&g, 'T', '1');  /* true */
+    G_LOAD_HEX(&g, 'T', 1);  /* true */
     G_RET(&g);
     
     /* ═══════════════════════════════════════════════════════════════════════
@@ -374,14 +372,14 @@ int main(void) {
     
     dict_header("<", 0);
     G_LABEL(&g, "prim_lt");
-    G_ADD(&g, 'S', 'S', '1');
-    G_LOAD_MEM(&g, 'N', 'S');
+    G_ADDI(&g, 'S', 'S', 4);
+    G_LOAD32_MEM(&g, 'N', 'S');
     G_LOAD16_LABEL(&g, 'a', "lt_true");
     G_JLT(&g, 'N', 'T', 'a');
-    G_COPY(&g, 'T', 'z');
+    G_LOAD_HEX(&g, 'T', 0);
     G_RET(&g);
     G_LABEL(&g, "lt_true");
-    G_COPY(&g, 'T', '1');
+    G_LOAD_HEX(&g, 'T', 1);
     G_RET(&g);
     
     /* ═══════════════════════════════════════════════════════════════════════
@@ -390,14 +388,14 @@ int main(void) {
     
     dict_header(">", 0);
     G_LABEL(&g, "prim_gt");
-    G_ADD(&g, 'S', 'S', '1');
-    G_LOAD_MEM(&g, 'N', 'S');
+    G_ADDI(&g, 'S', 'S', 4);
+    G_LOAD32_MEM(&g, 'N', 'S');
     G_LOAD16_LABEL(&g, 'a', "gt_true");
     G_JGT(&g, 'N', 'T', 'a');
-    G_COPY(&g, 'T', 'z');
+    G_LOAD_HEX(&g, 'T', 0);
     G_RET(&g);
     G_LABEL(&g, "gt_true");
-    G_COPY(&g, 'T', '1');
+    G_LOAD_HEX(&g, 'T', 1);
     G_RET(&g);
     
     /* ═══════════════════════════════════════════════════════════════════════
@@ -413,25 +411,25 @@ int main(void) {
     
     /* ═══════════════════════════════════════════════════════════════════════
      * PRIMITIVE: @ ( addr -- val )
-     * Fetch from memory
+     * Fetch a cell from memory
      * ═══════════════════════════════════════════════════════════════════════ */
     
     dict_header("@", 0);
     G_LABEL(&g, "prim_fetch");
-    G_LOAD_MEM(&g, 'T', 'T');
+    G_LOAD32_MEM(&g, 'T', 'T');
     G_RET(&g);
     
     /* ═══════════════════════════════════════════════════════════════════════
      * PRIMITIVE: ! ( val addr -- )
-     * Store to memory
+     * Store a cell to memory
      * ═══════════════════════════════════════════════════════════════════════ */
     
     dict_header("!", 0);
     G_LABEL(&g, "prim_store");
     /* addr in T, val in N */
-    G_ADD(&g, 'S', 'S', '1');
-    G_LOAD_MEM(&g, 'N', 'S');
-    G_STORE_MEM(&g, 'T', 'N');
+    G_ADDI(&g, 'S', 'S', 4);
+    G_LOAD32_MEM(&g, 'N', 'S');
+    G_STORE32_MEM(&g, 'T', 'N');
     emit_pop();
     G_RET(&g);
     
@@ -442,8 +440,7 @@ int main(void) {
     
     dict_header("C@", 0);
     G_LABEL(&g, "prim_cfetch");
-    G_LOAD_MEM(&g, 'T', 'T');
-    G_AND(&g, 'T', 'T', 'F');  /* Mask to byte... actually we need 0xFF */
+    G_LOAD_MEM(&g, 'T', 'T');     /* @< reads one byte, already 0-255 */
     G_RET(&g);
     
     /* ═══════════════════════════════════════════════════════════════════════
@@ -453,8 +450,8 @@ int main(void) {
     
     dict_header("C!", 0);
     G_LABEL(&g, "prim_cstore");
-    G_ADD(&g, 'S', 'S', '1');
-    G_LOAD_MEM(&g, 'N', 'S');
+    G_ADDI(&g, 'S', 'S', 4);
+    G_LOAD32_MEM(&g, 'N', 'S');
     G_STORE_MEM(&g, 'T', 'N');
     emit_pop();
     G_RET(&g);
@@ -482,7 +479,7 @@ int main(void) {
     /* Skip leading whitespace */
     G_LABEL(&g, "skip_ws");
     G_READ_PORT(&g, 'a', 'i');    /* Read char */
-    G_JEQ(&g, 'a', 'z', 'a');     /* EOF? Exit (jump to 0 = halt) */
+    G_JEQ(&g, 'a', 'z', 'E');     /* EOF? Exit */
     G_LOAD_LIT(&g, 'b', ' ');
     G_LOAD16_LABEL(&g, 'c', "skip_ws");
     G_JEQ(&g, 'a', 'b', 'c');     /* Space? Keep skipping */
@@ -493,12 +490,12 @@ int main(void) {
     
     /* Found non-whitespace, store it */
     G_STORE_MEM(&g, 'x', 'a');
-    G_ADD(&g, 'x', 'x', '1');
+    G_ADDI(&g, 'x', 'x', 1);
     
     /* Read rest of word */
     G_LABEL(&g, "read_word");
     G_READ_PORT(&g, 'a', 'i');
-    G_JEQ(&g, 'a', 'z', 'a');     /* EOF? Halt */
+    G_JEQ(&g, 'a', 'z', 'E');     /* EOF? Halt */
     G_LOAD_LIT(&g, 'b', ' ');
     G_LOAD16_LABEL(&g, 'c', "word_done");
     G_JEQ(&g, 'a', 'b', 'c');     /* Space? Word done */
@@ -508,7 +505,7 @@ int main(void) {
     G_JEQ(&g, 'a', 'b', 'c');     /* Tab? Word done */
     /* Store char */
     G_STORE_MEM(&g, 'x', 'a');
-    G_ADD(&g, 'x', 'x', '1');
+    G_ADDI(&g, 'x', 'x', 1);
     G_LOAD16_LABEL(&g, 'c', "read_word");
     G_JUMP(&g, 'c');
     
@@ -532,7 +529,7 @@ int main(void) {
     G_JEQ(&g, 'a', 'b', 'c');     /* == ':'? Not a number */
     
     /* It starts with a digit - parse full number */
-    G_COPY(&g, 'n', 'z');         /* n = accumulated value (0) */
+    G_LOAD_HEX(&g, 'n', 0);       /* n = accumulated value (0) */
     G_COPY(&g, 'x', 'W');         /* x = current position */
     G_LOAD_HEX(&g, 'f', 0xA);     /* f = 10 (for multiply) */
     
@@ -550,11 +547,10 @@ int main(void) {
     
     /* n = n * 10 + (a - '0') */
     G_MUL(&g, 'n', 'n', 'f');     /* n = n * 10 */
-    G_LOAD_LIT(&g, 'b', '0');
-    G_SUB(&g, 'a', 'a', 'b');     /* a = digit value */
+    G_SUBI(&g, 'a', 'a', '0');    /* a = digit value */
     G_ADD(&g, 'n', 'n', 'a');     /* n = n + digit */
     
-    G_ADD(&g, 'x', 'x', '1');     /* next char */
+    G_ADDI(&g, 'x', 'x', 1);      /* next char */
     G_LOAD16_LABEL(&g, 'c', "parse_num");
     G_JUMP(&g, 'c');
     
@@ -572,7 +568,7 @@ int main(void) {
     G_LABEL(&g, "try_find");
     
     /* d = LATEST (last dictionary entry) */
-    G_LOAD16(&g, 'd', last_word);
+    G_LOAD16_LABEL(&g, 'd', last_word);
     
     G_LABEL(&g, "find_loop");
     /* If d == 0, word not found */
@@ -580,48 +576,25 @@ int main(void) {
     G_JEQ(&g, 'd', 'z', 'c');
     
     /* Get entry length (at d+2, masked) */
-    G_ADD(&g, 'a', 'd', '1');
-    G_ADD(&g, 'a', 'a', '1');     /* a = d + 2 (flags+len byte) */
+    G_ADDI(&g, 'a', 'd', 2);      /* a = d + 2 (flags+len byte) */
     G_LOAD_MEM(&g, 'e', 'a');     /* e = flags+len */
-    G_LOAD_HEX(&g, 'b', 0x1F);    /* mask for length */
-    /* Need to build 0x1F = 31 */
-    G_LOAD_HEX(&g, 'b', 1);
-    G_SHL(&g, 'b', 'b', '4');
-    G_LOAD_HEX(&g, 'f', 0xF);
-    G_OR(&g, 'b', 'b', 'f');      /* b = 0x1F */
-    G_AND(&g, 'e', 'e', 'b');     /* e = name length */
+    G_ANDI(&g, 'e', 'e', 0x1F);   /* e = name length */
     
     /* Compare lengths */
     G_LOAD16_LABEL(&g, 'c', "find_next");
     G_JNE(&g, 'e', 'y', 'c');     /* Different length? Next entry */
     
     /* Compare names */
-    G_ADD(&g, 'a', 'a', '1');     /* a = start of name in dict */
-    G_COPY(&g, 'b', 'W');         /* b = start of word buffer */
-    G_COPY(&g, 'f', 'e');         /* f = counter */
-    
-    G_LABEL(&g, "cmp_loop");
+    G_ADDI(&g, 'a', 'a', 1);      /* a = start of name in dict */
+    G_CMP_MEM(&g, 'a', 'W', 'e'); /* name against word buffer, e bytes */
+    G_ADD(&g, 'a', 'a', 'e');     /* a = past the name */
+    G_LEAP(&g, '!', 'c');         /* Mismatch? Next entry (c is find_next) */
     G_LOAD16_LABEL(&g, 'c', "found");
-    G_JEQ(&g, 'f', 'z', 'c');     /* All chars matched? Found! */
-    
-    G_LOAD_MEM(&g, 'n', 'a');     /* n = dict char */
-    G_LOAD_MEM(&g, 'p', 'b');     /* p = word char */
-    G_LOAD16_LABEL(&g, 'c', "find_next");
-    G_JNE(&g, 'n', 'p', 'c');     /* Mismatch? Next entry */
-    
-    G_ADD(&g, 'a', 'a', '1');
-    G_ADD(&g, 'b', 'b', '1');
-    G_SUB(&g, 'f', 'f', '1');
-    G_LOAD16_LABEL(&g, 'c', "cmp_loop");
-    G_JUMP(&g, 'c');
+    G_JUMP(&g, 'c');              /* Found! */
     
     G_LABEL(&g, "find_next");
     /* d = link at d */
-    G_LOAD_MEM(&g, 'a', 'd');     /* Low byte of link */
-    G_ADD(&g, 'b', 'd', '1');
-    G_LOAD_MEM(&g, 'b', 'b');     /* High byte of link */
-    G_SHL(&g, 'b', 'b', '8');
-    G_OR(&g, 'd', 'a', 'b');      /* d = link */
+    G_LOAD16_MEM(&g, 'd', 'd');
     G_LOAD16_LABEL(&g, 'c', "find_loop");
     G_JUMP(&g, 'c');
     
@@ -654,7 +627,7 @@ int main(void) {
     G_LOAD16_LABEL(&g, 'c', "print_word_done");
     G_JEQ(&g, 'b', 'z', 'c');
     G_WRITE_PORT(&g, 'o', 'b');
-    G_ADD(&g, 'a', 'a', '1');
+    G_ADDI(&g, 'a', 'a', 1);
     G_LOAD16_LABEL(&g, 'c', "print_word");
     G_JUMP(&g, 'c');
     G_LABEL(&g, "print_word_done");
@@ -669,6 +642,10 @@ int main(void) {
      * Resolve and write
      * ═══════════════════════════════════════════════════════════════════════ */
     
+    if (optimize && glyph_optimize(&g, &opt) < 0) {
+        fprintf(stderr, "Error: out of memory optimizing\n");
+        return 1;
+    }
     if (glyph_resolve(&g) < 0) {
         fprintf(stderr, "Error resolving labels\n");
         return 1;
@@ -676,6 +653,9 @@ int main(void) {
     
     printf("; GlyphForth - A minimal Forth interpreter\n");
     printf("; Size: %u bytes\n", g.pos);
+    if (optimize)
+        printf("; Optimizer: %u -> %u instructions, %u -> %u bytes before relaxing\n",
+               opt.insns_before, opt.insns_after, opt.bytes_before, opt.bytes_after);
     printf("; Dictionary entries: %d\n", g.label_count);
     printf(";\n");
     printf("; Labels:\n");
@@ -683,7 +663,7 @@ int main(void) {
         printf(";   %-20s = 0x%04X\n", g.labels[i].name, g.labels[i].addr);
     }
     printf(";\n");
-    printf("; LATEST word at: 0x%04X\n", last_word);
+    printf("; LATEST word at: 0x%04X\n", glyph_find_label(&g, last_word));
     
     if (glyph_write(&g, "examples/forth.glyph") < 0) {
         fprintf(stderr, "Error writing output\n");
@@ -697,5 +677,6 @@ int main(void) {
     printf(";      5 DUP * . CR\n");
     printf(";      BYE\n");
     
+    glyph_free_asm(&g);
     return 0;
 }
@@ -12,19 +12,12 @@
 
 /* 
  * Register allocation:
- *   H, L  - Address high/low bytes (H:L is 16-bit address counter)
+ *   L     - 16-bit address counter
  *   b     - Current input byte
  *   n     - Temp for hex conversion
  *   p     - Char to print
- *   t     - Temp for division
- *   z     - Zero constant
- *   1     - One constant
- *   4     - Four constant (for shifts)
- *   8     - Eight constant (for shifts)
- *   A     - Ten constant (for hex conversion)
- *   F     - 0x0F mask
- *   D     - '0' (48) constant
- *   7     - 7 constant (for A-F offset)
+ *   X     - Hex digit table address
+ *   z     - Zero constant (compares take registers)
  *   S     - Space character
  *   N     - Newline character
  *   Q     - Quote character
@@ -34,38 +27,29 @@
  *   E     - Exit address (for EOF)
  */
 
-static uint8_t buffer[4096];
-
 /* Emit hex digit print: print nibble in 'n' as hex char */
 static void emit_print_hex_nibble(GlyphAsm *g) {
-    /* Branchless: char = n + '0' + (n/10)*7
-     * If n < 10: n + 48 + 0 = digit
-     * If n >= 10: n + 48 + 7 = letter
-     */
-    G_ADD(g, 'p', 'n', 'D');      /* p = n + '0' */
-    G_DIV(g, 't', 'n', 'A');      /* t = n / 10 (0 or 1) */
-    G_MUL(g, 't', 't', '7');      /* t = t * 7 */
-    G_ADD(g, 'p', 'p', 't');      /* p = p + t */
+    G_ADD(g, 'p', 'X', 'n');      /* p = &hex[n] */
+    G_LOAD_MEM(g, 'p', 'p');      /* p = hex[n] */
     G_WRITE_PORT(g, 'w', 'p');    /* print p */
 }
 
-/* Emit code to print byte in register as 2 hex digits */
-static void emit_print_hex_byte(GlyphAsm *g, char reg) {
-    /* High nibble */
-    G_COPY(g, 'n', reg);
-    G_SHR(g, 'n', 'n', '4');      /* n = reg >> 4 */
-    G_AND(g, 'n', 'n', 'F');      /* n = n & 0x0F */
-    emit_print_hex_nibble(g);
-    
-    /* Low nibble */
-    G_COPY(g, 'n', reg);
-    G_AND(g, 'n', 'n', 'F');      /* n = reg & 0x0F */
+/* Emit code to print the low 4 * digits bits of a register in hex */
+static void emit_print_hex(GlyphAsm *g, char reg, int digits) {
+    for (int i = digits - 1; i > 0; i--) {
+        G_SHRI(g, 'n', reg, 4 * i);   /* n = reg >> 4i */
+        G_ANDI(g, 'n', 'n', 0xF);     /* n = n & 0x0F */
+        emit_print_hex_nibble(g);
+    }
+    G_ANDI(g, 'n', reg, 0xF);         /* n = reg & 0x0F */
     emit_print_hex_nibble(g);
 }
 
-int main(void) {
+int main(int argc, char **argv) {
+    int optimize = !(argc > 1 && strcmp(argv[1], "-O0") == 0);
+    GlyphOptStats opt = { 0, 0, 0, 0 };
     GlyphAsm g;
-    glyph_init_asm(&g, buffer, sizeof(buffer));
+    glyph_init_asm(&g, NULL, 0);
     
     /* ─────────────────────────────────────────────────────────────────────
      * Initialization
@@ -76,18 +60,10 @@ int main(void) {
     G_LOAD_LIT(&g, 'i', 'c');     /* i = stdin port */
     
     /* Address counter starts at 0x0100 */
-    G_LOAD_HEX(&g, 'H', 1);       /* H = 1 (high byte) */
-    G_LOAD_HEX(&g, 'L', 0);       /* L = 0 (low byte) */
+    G_LOAD16(&g, 'L', 0x0100);
     
     /* Constants */
-    G_LOAD_HEX(&g, 'z', 0);       /* z = 0 */
-    G_LOAD_HEX(&g, '1', 1);       /* 1 = 1 */
-    G_LOAD_HEX(&g, '4', 4);       /* 4 = 4 */
-    G_LOAD_HEX(&g, '8', 8);       /* 8 = 8 */
-    G_LOAD_HEX(&g, 'A', 0xA);     /* A = 10 */
-    G_LOAD_HEX(&g, 'F', 0xF);     /* F = 15 (mask) */
-    G_LOAD_LIT(&g, 'D', '0');     /* D = '0' (48) */
-    G_LOAD_HEX(&g, '7', 7);       /* 7 = 7 */
+    G_CONST(&g, 'z', 0);          /* z = 0 */
     G_LOAD_LIT(&g, 'S', ' ');     /* S = space */
     G_LOAD_LIT(&g, 'N', '\n');    /* N = newline */
     G_LOAD_LIT(&g, 'Q', '\'');    /* Q = quote */
@@ -95,6 +71,7 @@ int main(void) {
     /* Forward references for jump targets */
     G_LOAD16_LABEL(&g, 'M', "loop");
     G_LOAD16_LABEL(&g, 'E', "exit");
+    G_LOAD16_LABEL(&g, 'X', "hex");
     
     /* ─────────────────────────────────────────────────────────────────────
      * Main Loop
@@ -108,18 +85,15 @@ int main(void) {
     /* If b == 0 (EOF), exit */
     G_JEQ(&g, 'b', 'z', 'E');
     
-    /* Print address high byte (H) */
-    emit_print_hex_byte(&g, 'H');
-    
-    /* Print address low byte (L) */
-    emit_print_hex_byte(&g, 'L');
+    /* Print the address */
+    emit_print_hex(&g, 'L', 4);
     
     /* Print "  " (two spaces) */
     G_WRITE_PORT(&g, 'w', 'S');
     G_WRITE_PORT(&g, 'w', 'S');
     
     /* Print byte value in hex */
-    emit_print_hex_byte(&g, 'b');
+    emit_print_hex(&g, 'b', 2);
     
     /* Print "  '" */
     G_WRITE_PORT(&g, 'w', 'S');
@@ -134,11 +108,9 @@ int main(void) {
     G_WRITE_PORT(&g, 'w', 'Q');
     G_WRITE_PORT(&g, 'w', 'N');
     
-    /* Increment 16-bit address (L++, if L==0 then H++) */
-    G_ADD(&g, 'L', 'L', '1');
-    G_JNE(&g, 'L', 'z', 'M');     /* If L != 0, loop */
-    G_ADD(&g, 'H', 'H', '1');     /* L wrapped, increment H */
-    G_JUMP(&g, 'M');              /* Loop */
+    /* Increment the address and loop */
+    G_ADDI(&g, 'L', 'L', 1);
+    G_JUMP(&g, 'M');
     
     /* ─────────────────────────────────────────────────────────────────────
      * Exit
@@ -148,10 +120,17 @@ int main(void) {
     /* Program ends naturally (halt on unknown opcode or null) */
     G_EMIT(&g, 0);
     
+    G_LABEL(&g, "hex");
+    for (const char *d = "0123456789ABCDEF"; *d; d++) G_DATA(&g, *d);
+    
     /* ─────────────────────────────────────────────────────────────────────
      * Resolve labels and write output
      * ───────────────────────────────────────────────────────────────────── */
     
+    if (optimize && glyph_optimize(&g, &opt) < 0) {
+        fprintf(stderr, "Error: out of memory optimizing\n");
+        return 1;
+    }
     if (glyph_resolve(&g) < 0) {
         fprintf(stderr, "Error resolving labels\n");
         return 1;
@@ -160,6 +139,9 @@ int main(void) {
     /* Print stats */
     printf("; Generated glyph-addr.glyph\n");
     printf("; Size: %u bytes\n", g.pos);
+    if (optimize)
+        printf("; Optimizer: %u -> %u instructions, %u -> %u bytes before relaxing\n",
+               opt.insns_before, opt.insns_after, opt.bytes_before, opt.bytes_after);
     printf("; Labels:\n");
     for (int i = 0; i < g.label_count; i++) {
         printf(";   %s = 0x%04X\n", g.labels[i].name, g.labels[i].addr);
@@ -171,5 +153,6 @@ int main(void) {
     }
     
     printf("; Written to examples/glyph-addr.glyph\n");
+    glyph_free_asm(&g);
     return 0;
 }
@@ -0,0 +1,284 @@
+/*
+ * glyph-bench - Benchmark suite for the Glyph VM
+ *
+ * Runs a set of workloads through the predecoded engine and reports
+ * instructions per second, ns per instruction and wall time per run. The
+ * engine is picked when glyph.h is compiled: labels-as-values threading by
+ * default, the portable switch with -DGLYPH_NO_THREADED, and threading
+ * plus the x86-64 JIT tier with -DGLYPH_JIT. `make bench` runs the suite
+ * and writes bench.json; `make bench-dispatch` compares all three engines.
+ *
+ * Workloads:
+ *   alu     - hashing loop: long straight runs of arithmetic and loads
+ *             between leaps, the JIT's best case
+ *   copy    - byte copy loop through @< and @>, every store a real write
+ *   recurse - 126-deep ; recursion, unwound by , 4096 times
+ *   skip    - a loop that jumps over {} definitions and [] blocks
+ *   ports   - literal port writes, one emit callback each
+ *   mixed   - Forth-style inner loop: calls, stack traffic, compares and
+ *             leaps, like the code gen-forth.c produces
+ *   forth   - the given image (default examples/forth.glyph), with a
+ *             scripted Forth session of SCRIPT_LINES lines fed to port 'c';
+ *             its output on port 'o' must match, so a broken image fails
+ *
+ * Each workload gets warm-up runs, then timed runs until both MIN_RUNS and
+ * -t seconds are reached. Mean, standard deviation and the fastest run are
+ * reported; -o writes the same numbers as JSON for tracking regressions.
+ *
+ * Usage: glyph-bench [-t seconds] [-o out.json] [program.glyph] [input]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define GLYPH_IMPL
+#include "../glyph.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(GLYPH_JIT)
+#define ENGINE "jit"
+#elif defined(GLYPH_THREADED)
+#define ENGINE "threaded"
+#else
+#define ENGINE "switch"
+#endif
+
+#define MEM_SIZE    0x10000
+#define WARMUP_TIME 0.1      /* seconds of untimed runs first */
+#define MIN_RUNS    5
+#define MAX_RUNS    1000
+#define SCRIPT_LINES 512     /* repeats of the scripted Forth line */
+#define OUT_SIZE    0x4000
+
+static Glyph vm;
+static u8 mem[MEM_SIZE];
+static u8 image[MEM_SIZE];
+static GlyphOp code[MEM_SIZE];
+#ifdef GLYPH_JIT
+static GlyphJit jit;
+#endif
+static size_t image_len;
+
+/* The scripted session: SCRIPT_LINES copies of line, then BYE */
+static const char *line   = "3 4 + . CR 5 DUP * . CR 10 2 - . CR\n";
+static const char *answer = "7 \n25 \n8 \n";
+static char script[SCRIPT_LINES * 40 + 8];
+static char expected[SCRIPT_LINES * 16 + 8];
+
+static const char *input = script;
+static const char *in_pos;
+static char out[OUT_SIZE];  /* bytes written to port 'o' */
+static size_t out_len;
+
+/* ~1.4M iterations, 16 straight-line runes per leap */
+static const char *alu =
+    ":011 :0kf :0cf *kkc *kkc *kkc *kkc :0m7 :05d "
+    "'L +hhk *hhm :.th >tt5 ^hht @<xh +aax &ccb |dde -ffa ~gf +iig "
+    "-kk1 ?kz .!L";
+
+/* 4096 passes copying 256 bytes from 0x4000 to 0x8000, adding the pass count */
+static const char *copy =
+    ":011 :0tc :0e8 :0r1 <rrt "
+    "'O :0s4 <sst :0d8 <ddt :0n1 <nne "
+    "'L @<vs +vvr @>dv +ss1 +dd1 -nn1 ?nz .!L "
+    "-rr1 ?rz .!O";
+
+/* R calls itself until d reaches zero */
+static const char *recurse =
+    ":011 :0tc :0r1 <rrt :'h~ "
+    "{R -dd1 ?dz [=E ;R ]E , }R "
+    "'O :.dh ;R -rr1 ?rz .!O";
+
+/* 2^18 passes over two definitions and two taken [] skips, each hiding
+ * 200 bytes of runes that never run */
+#define HIDDEN \
+    "+aab +aab +aab +aab +aab +aab +aab +aab +aab +aab " \
+    "+aab +aab +aab +aab +aab +aab +aab +aab +aab +aab " \
+    "+aab +aab +aab +aab +aab +aab +aab +aab +aab +aab " \
+    "+aab +aab +aab +aab +aab +aab +aab +aab +aab +aab "
+static const char *skip =
+    ":011 :0tc :0s6 :0r1 <rrt <rrs "
+    "'O {A " HIDDEN "}A {B " HIDDEN "}B "
+    "?rr [=C " HIDDEN "]C [=D " HIDDEN "]D "
+    "-rr1 ?rz .!O";
+
+/* 2^20 passes of two literal port writes */
+static const char *ports =
+    ":011 :0ta :0r1 <rrt <rrt "
+    "'O :'po #>pr :'pe #>pr -rr1 ?rz .!O";
+
+/* Forth-style inner loop: push/pop through memory, ~1M iterations */
+static const char *mixed =
+    ":011 :0S8 :0tC <SSt :0k1 :0sF :0t5 +sst <kks "
+    "{P @>ST -SS1 , }P "
+    "{Q +SS1 @<TS , }Q "
+    "{A ;P +TT1 ;P ;Q ;Q , }A "
+    ":0T0 :0n0 "
+    "'L ;A +nn1 :.Tn ?nk .!L";
+
+typedef struct {
+    const char *name;
+    u64 steps;         /* per run */
+    int runs;
+    double mean, sd, min;  /* seconds per run */
+} Result;
+
+static void bench_emit(Glyph *vm, void *user, u8 port) {
+    (void)user;
+    if (port == 'o' && out_len < OUT_SIZE)
+        out[out_len++] = (char)vm->port[port];
+}
+
+static void bench_sense(Glyph *vm, void *user, u8 port) {
+    (void)user;
+    if (port == 'c')
+        vm->port['c'] = *in_pos ? (u8)*in_pos++ : 0;
+}
+
+static void load(const u8 *prog, size_t len) {
+    glyph_init(&vm, mem, MEM_SIZE);
+    vm.emit = bench_emit;
+    vm.sense = bench_sense;
+    in_pos = input;
+    out_len = 0;
+    memset(mem, 0, MEM_SIZE);
+    memcpy(mem, prog, len);
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* One fresh run; returns its wall time. With expect, the console output
+ * must match it. */
+static double run_once(const u8 *prog, size_t len, const char *expect) {
+    load(prog, len);
+    glyph_predecode(&vm, code);
+#ifdef GLYPH_JIT
+    if (glyph_jit_init(&vm, &jit, 1 << 20) < 0) {
+        fprintf(stderr, "Error: JIT unavailable\n");
+        exit(1);
+    }
+#endif
+    double t0 = now();
+    glyph_run(&vm);
+    double t = now() - t0;
+#ifdef GLYPH_JIT
+    glyph_jit_free(&vm, &jit);
+#endif
+    if (vm.trap) {
+        fprintf(stderr, "Error: workload trapped at 0x%04x\n", vm.reg['.']);
+        exit(1);
+    }
+    if (expect && (out_len != strlen(expect) || memcmp(out, expect, out_len))) {
+        fprintf(stderr, "Error: workload printed %zu bytes, not the expected %zu\n",
+                out_len, strlen(expect));
+        exit(1);
+    }
+    return t;
+}
+
+static Result bench(const char *name, const u8 *prog, size_t len,
+                    const char *expect, double min_time) {
+    static double times[MAX_RUNS];
+    Result r = { .name = name };
+    double total = 0;
+
+    for (double end = now() + WARMUP_TIME; now() < end;)
+        run_once(prog, len, expect);
+
+    while (r.runs < MAX_RUNS && (r.runs < MIN_RUNS || total < min_time)) {
+        times[r.runs] = run_once(prog, len, expect);
+        total += times[r.runs++];
+    }
+    r.steps = vm.steps;
+    r.mean = total / r.runs;
+    r.min = times[0];
+    for (int i = 0; i < r.runs; i++) {
+        r.sd += (times[i] - r.mean) * (times[i] - r.mean);
+        if (times[i] < r.min) r.min = times[i];
+    }
+    r.sd = r.runs > 1 ? sqrt(r.sd / (r.runs - 1)) : 0;
+
+    printf("%-8s %-8s %12lu %5d %9.3f ms %5.1f%% %9.1f %7.2f\n", ENGINE, name,
+           (unsigned long)r.steps, r.runs, r.mean * 1e3, 100 * r.sd / r.mean,
+           r.steps / r.mean / 1e6, r.mean / r.steps * 1e9);
+    return r;
+}
+
+static void write_json(const char *path, const Result *r, int n) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Error: cannot write '%s'\n", path);
+        exit(1);
+    }
+    fprintf(f, "{\"engine\": \"%s\", \"workloads\": [\n", ENGINE);
+    for (int i = 0; i < n; i++)
+        fprintf(f, "  {\"name\": \"%s\", \"steps\": %lu, \"runs\": %d, "
+                "\"wall_mean_s\": %.9f, \"wall_sd_s\": %.9f, \"wall_min_s\": %.9f, "
+                "\"minstr_per_s\": %.3f, \"ns_per_instr\": %.4f}%s\n",
+                r[i].name, (unsigned long)r[i].steps, r[i].runs,
+                r[i].mean, r[i].sd, r[i].min, r[i].steps / r[i].mean / 1e6,
+                r[i].mean / r[i].steps * 1e9, i + 1 < n ? "," : "");
+    fprintf(f, "]}\n");
+    fclose(f);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-t seconds] [-o out.json] [program.glyph] [input]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    const char *path = "examples/forth.glyph", *json = NULL;
+    double min_time = 0.5;
+    int i = 1;
+
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        if      (!strcmp(argv[i], "-t")) min_time = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "-o")) json = argv[i + 1];
+        else break;
+    }
+    if (i < argc && argv[i][0] == '-') {
+        usage(argv[0]);
+        return 1;
+    }
+    if (i < argc) path = argv[i];
+    if (i + 1 < argc) input = argv[i + 1];
+
+    /* The Forth prompt comes once, before the first line */
+    strcpy(expected, "> ");
+    for (int k = 0; k < SCRIPT_LINES; k++) {
+        strcat(script, line);
+        strcat(expected, answer);
+    }
+    strcat(script, "BYE\n");
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Error: cannot open '%s'\n", path);
+        return 1;
+    }
+    image_len = fread(image, 1, MEM_SIZE, f);
+    fclose(f);
+
+    const struct { const char *name; const u8 *prog; size_t len; const char *expect; } work[] = {
+        { "alu",     (const u8 *)alu,     strlen(alu),     NULL },
+        { "copy",    (const u8 *)copy,    strlen(copy),    NULL },
+        { "recurse", (const u8 *)recurse, strlen(recurse), NULL },
+        { "skip",    (const u8 *)skip,    strlen(skip),    NULL },
+        { "ports",   (const u8 *)ports,   strlen(ports),   NULL },
+        { "mixed",   (const u8 *)mixed,   strlen(mixed),   NULL },
+        { "forth",   image,               image_len,       input == script ? expected : NULL },
+    };
+    int n = sizeof(work) / sizeof(work[0]);
+    Result r[sizeof(work) / sizeof(work[0])];
+
+    printf("engine   workload        steps  runs   wall/run    sd   Minstr/s ns/inst\n");
+    for (int k = 0; k < n; k++)
+        r[k] = bench(work[k].name, work[k].prog, work[k].len, work[k].expect, min_time);
+    if (json) write_json(json, r, n);
+    return 0;
+}
@@ -1,17 +1,28 @@
 /*
  * glyph-dis - Glyph Disassembler
- * 
- * Disassembles Glyph bytecode into human-readable form.
- * 
- * Usage: glyph-dis <file.glyph>
+ *
+ * Disassembles Glyph bytecode into human-readable form. Runes are read
+ * with the encoding table in glyph-ops.h, the one the VM decodes with, so
+ * every form shows as it runs. Whitespace is skipped.
+ *
+ * Every byte is decoded as a rune, data included: gen-forth interleaves
+ * dictionary headers with the code of each word, so what decodes as
+ * unknown runes between words is usually a header. For images that keep
+ * only data after their code, -s stops decoding at the first \0 halt and
+ * dumps the rest as bytes.
+ *
+ * Usage: glyph-dis [-s] <file.glyph>
+ *        glyph-dis [-s] -e "<code>"
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <ctype.h>
+#include "../glyph-ops.h"
 
-#define BASE_ADDR 0x0100
+#define BASE_ADDR 0x0000   /* Programs are loaded at the start of memory */
 
 static const char *data;
 static size_t data_len;
@@ -21,10 +32,6 @@ static int peek(void) {
     return (pos < data_len) ? (unsigned char)data[pos] : -1;
 }
 
-static int next(void) {
-    return (pos < data_len) ? (unsigned char)data[pos++] : -1;
-}
-
 static void print_char(int c) {
     if (c >= 32 && c < 127)
         printf("'%c'", c);
@@ -32,189 +39,188 @@ static void print_char(int c) {
         printf("0x%02X", c);
 }
 
-static void disasm_one(void) {
+/* A register or block name: the glyph itself when it prints */
+static void print_name(int c) {
+    if (isgraph(c)) putchar(c);
+    else printf("0x%02X", c);
+}
+
+/* Length and form of the rune at p; len 0 if it is not one */
+static int lookup(const unsigned char *p, size_t avail, const char **args,
+                  const char **text, int *moded) {
+    int len = 0;
+    *args = *text = NULL;
+    *moded = 0;
+    switch (p[0]) {
+#define GLYPH_RUNE(r, l, m) case r: len = l; *moded = m; break;
+    GLYPH_RUNES(GLYPH_RUNE)
+#undef GLYPH_RUNE
+    }
+    if (!len || (size_t)len > avail) return len;
+    switch (p[0] << 8 | (*moded ? p[1] : 0)) {
+#define GLYPH_FORM(r, m, n, ar, t) case (r) << 8 | (m): *args = ar; *text = t; break;
+    GLYPH_FORMS(GLYPH_FORM)
+#undef GLYPH_FORM
+    }
+    return len;
+}
+
+/* The rest of the image as hex and text, 16 bytes a line */
+static void dump_data(void) {
+    while (pos < data_len) {
+        size_t n = data_len - pos < 16 ? data_len - pos : 16;
+        printf("%04X: ", (unsigned)(BASE_ADDR + pos));
+        for (size_t i = 0; i < 16; i++) {
+            if (i < n) printf("%02X ", (unsigned char)data[pos + i]);
+            else printf("   ");
+        }
+        printf("; ");
+        for (size_t i = 0; i < n; i++) {
+            int c = (unsigned char)data[pos + i];
+            putchar(c >= 32 && c < 127 ? c : '.');
+        }
+        printf("\n");
+        pos += n;
+    }
+}
+
+/* Returns 1 after a \0 halt */
+static int disasm_one(void) {
     unsigned int addr = BASE_ADDR + pos;
-    int op = next();
-    if (op < 0) return;
-    
+    const unsigned char *p = (const unsigned char *)data + pos;
+    size_t avail = data_len - pos;
+    const char *args, *text;
+    int moded, len = lookup(p, avail, &args, &text, &moded);
+
+    /* Whitespace separates runes; the addresses show the gap */
+    if (len == 1 && p[0] && isspace(p[0])) {
+        while (peek() > 0 && isspace(peek())) pos++;
+        return 0;
+    }
+
     printf("%04X: ", addr);
-    
-    int a, b, c, d;
-    
-    switch (op) {
-    /* Arithmetic */
-    case '+': case '-': case '*': case '/': case '%':
-        a = next(); b = next(); c = next();
-        printf("%c%c%c%c      ; %c = %c %c %c\n", 
-               op, a, b, c, a, b, op, c);
-        break;
-    
-    /* Bitwise (3 operands) */
-    case '&': case '|': case '^': case '<': case '>':
-        a = next(); b = next(); c = next();
-        if (op == '<')
-            printf("<%c%c%c      ; %c = %c << %c\n", a, b, c, a, b, c);
-        else if (op == '>')
-            printf(">%c%c%c      ; %c = %c >> %c\n", a, b, c, a, b, c);
-        else
-            printf("%c%c%c%c      ; %c = %c %c %c\n", op, a, b, c, a, b, op, c);
-        break;
-    
-    /* Bitwise NOT (2 operands) */
-    case '~':
-        a = next(); b = next();
-        printf("~%c%c       ; %c = ~%c\n", a, b, a, b);
-        break;
-    
-    /* Load */
-    case ':':
-        a = next(); b = next();
-        if (b == 'g') {
-            c = next();
-            printf(":%c%c", a, b);
-            print_char(c);
-            printf("    ; %c = ", a);
-            print_char(c);
-            printf(" (%d)\n", c);
-        } else if (b == 'x') {
-            c = next();
-            int val = (c <= '9') ? c - '0' : (c | 32) - 'a' + 10;
-            printf(":%c%c%c      ; %c = 0x%X (%d)\n", a, b, c, a, val, val);
-        } else if (b == '.') {
-            c = next();
-            printf(":%c.%c      ; %c = %c\n", a, c, a, c);
-        } else {
-            printf(":%c%c       ; ??? (invalid load mode)\n", a, b);
-        }
-        break;
-    
-    /* Memory */
-    case '@':
-        a = next(); b = next();
-        printf("@%c%c       ; %c = mem[%c]\n", a, b, a, b);
-        break;
-    case '!':
-        a = next(); b = next();
-        printf("!%c%c       ; mem[%c] = %c\n", a, b, a, b);
-        break;
-    
-    /* Ports */
-    case '#':
-        a = next(); b = next(); c = next();
-        if (a == '<') {
-            printf("#<%c%c      ; %c = port[%c]", b, c, b, c);
-            if (c == 'c' || (c >= '0' && c <= '9' && data[pos-1] == 'c'))
-                printf(" (stdin)");
-            printf("\n");
-        } else if (a == '>') {
-            printf("#>%c%c      ; port[%c] = %c", b, c, b, c);
-            if (b == 'o') printf(" (stdout)");
-            else if (b == 'e') printf(" (stderr)");
-            else if (b == 'X') printf(" (exit)");
-            printf("\n");
+
+    /* Unknown rune, or one cut off by the end of the file */
+    if (!len || (size_t)len > avail) {
+        pos++;
+        print_name(p[0]);
+        printf("%*s; ??? ", isgraph(p[0]) ? 7 : 4, "");
+        if (len) printf("(rune cut off by the end of the file)\n");
+        else printf("(unknown rune 0x%02X, traps)\n", p[0]);
+        return 0;
+    }
+    pos += len;
+
+    /* The rune as written */
+    int shown = 0;
+    for (int i = 0; i < len; i++) {
+        if (p[i] >= 33 && p[i] < 127) shown += printf("%c", p[i]);
+        else if (p[i] == 0) shown += printf("\\0");
+        else shown += printf("\\x%02X", p[i]);
+    }
+    printf("%*s; ", shown < 8 ? 8 - shown : 1, "");
+
+    if (!args) {
+        printf("??? (unknown mode ");
+        print_char(p[1]);
+        printf(", does nothing)\n");
+        return 0;
+    }
+
+    /* Operands by slot, as the VM decodes them */
+    int slot[3] = { -1, -1, -1 }, kind[3] = { 0, 0, 0 };
+    for (int i = 0; args[i]; i++) {
+        int s = (args[i] == 'l' || args[i] == 'h') ? 2 : i;
+        slot[s] = p[1 + moded + i];
+        kind[s] = args[i];
+    }
+    for (const char *t = text; *t; t++) {
+        int s = *t - 'A';
+        if (s < 0 || s > 2 || slot[s] < 0) { putchar(*t); continue; }
+        if (kind[s] == 'l') {
+            print_char(slot[s]);
+            printf(" (%d)", slot[s]);
+        } else if (kind[s] == 'h') {
+            uint32_t v = GLYPH_HEX(slot[s]);
+            printf("0x%X (%u)", v, v);
         } else {
-            printf("#%c%c%c      ; ??? (invalid port op)\n", a, b, c);
+            print_name(kind[s] == 'r' ? slot[s] & 127 : slot[s]);
         }
-        break;
-    
-    /* Control flow */
-    case '.':
-        a = next();
-        printf(".%c        ; jump to %c\n", a, a);
-        break;
-    
-    case '?':
-        a = next(); b = next(); c = next(); d = next();
-        printf("?%c%c%c%c     ; if %c %c %c then jump to %c\n", 
-               a, b, c, d, b, a, c, d);
-        break;
-    
-    case ';':
-        a = next();
-        printf(";%c        ; call %c\n", a, a);
-        break;
-    
-    case ',':
-        printf(",         ; return\n");
-        break;
-    
-    /* Whitespace */
-    case ' ': case '\t': case '\n': case '\r': case '\f': case '\v':
-        printf("          ; (whitespace)\n");
-        break;
-    
-    /* Null terminator */
-    case 0:
-        printf("\\0        ; halt\n");
-        break;
-    
-    /* Unknown */
-    default:
-        printf("%c         ; ??? (unknown opcode 0x%02X)\n", 
-               (op >= 32 && op < 127) ? op : '?', op);
-        break;
     }
+    printf("\n");
+    return p[0] == 0;
 }
 
 static void usage(const char *prog) {
     fprintf(stderr, "glyph-dis: Glyph Disassembler\n\n");
-    fprintf(stderr, "Usage: %s <file.glyph>\n", prog);
-    fprintf(stderr, "       %s -e \"<code>\"\n", prog);
+    fprintf(stderr, "Usage: %s [-s] <file.glyph>\n", prog);
+    fprintf(stderr, "       %s [-s] -e \"<code>\"\n", prog);
+    fprintf(stderr, "\nEvery byte is decoded, data too. -s stops at the first \\0\n");
+    fprintf(stderr, "halt and dumps the rest as data.\n");
 }
 
 int main(int argc, char **argv) {
-    if (argc < 2) {
+    int stop = 0, i = 1;
+
+    if (i < argc && strcmp(argv[i], "-s") == 0) {
+        stop = 1;
+        i++;
+    }
+    if (i >= argc) {
         usage(argv[0]);
         return 1;
     }
-    
-    if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+
+    if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
         usage(argv[0]);
         return 0;
     }
-    
+
     char *buf = NULL;
-    
-    if (strcmp(argv[1], "-e") == 0) {
-        if (argc < 3) {
+
+    if (strcmp(argv[i], "-e") == 0) {
+        if (i + 1 >= argc) {
             fprintf(stderr, "Error: -e requires code argument\n");
             return 1;
         }
-        data = argv[2];
-        data_len = strlen(argv[2]);
+        data = argv[i + 1];
+        data_len = strlen(argv[i + 1]);
     } else {
-        FILE *f = fopen(argv[1], "rb");
+        FILE *f = fopen(argv[i], "rb");
         if (!f) {
-            fprintf(stderr, "Error: cannot open '%s'\n", argv[1]);
+            fprintf(stderr, "Error: cannot open '%s'\n", argv[i]);
             return 1;
         }
-        
+
         fseek(f, 0, SEEK_END);
         long size = ftell(f);
         fseek(f, 0, SEEK_SET);
-        
+
         buf = malloc(size);
         if (!buf) {
             fprintf(stderr, "Error: out of memory\n");
             fclose(f);
             return 1;
         }
-        
+
         data_len = fread(buf, 1, size, f);
         fclose(f);
         data = buf;
     }
-    
+
     printf("; Glyph Disassembly - %zu bytes\n", data_len);
     printf("; Base address: 0x%04X\n\n", BASE_ADDR);
-    
+
     pos = 0;
     while (pos < data_len) {
-        disasm_one();
+        if (disasm_one() && stop && pos < data_len) {
+            printf("\n; Data after the halt\n");
+            dump_data();
+        }
     }
-    
+
     printf("\n; End at 0x%04X\n", (unsigned)(BASE_ADDR + pos));
-    
+
     free(buf);
     return 0;
 }
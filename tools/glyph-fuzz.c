@@ -0,0 +1,306 @@
+/*
+ * glyph-fuzz - Differential fuzzer across the Glyph engines
+ *
+ * Every input is a memory image of up to MEM_SIZE bytes. It runs under
+ * the reference stepper, the decode cache in one call, the decode cache in
+ * random small glyph_run_for slices and, built with -DGLYPH_JIT, the JIT
+ * tier compiling every target on first sight. Each run is capped at
+ * MAX_STEPS, with a call stack of STACK_DEPTH frames so overflow traps are
+ * reached too. Registers, memory, ports, the call stack, halt and trap state
+ * and the order of port traffic must all match the reference; if not, the
+ * difference is printed and the harness aborts.
+ *
+ * The same file builds three ways:
+ *   cc tools/glyph-fuzz.c               random well-formed programs
+ *   clang -fsanitize=fuzzer -DGLYPH_LIBFUZZER tools/glyph-fuzz.c
+ *                                       libFuzzer target
+ *   afl-clang-fast tools/glyph-fuzz.c   AFL: glyph-fuzz @@ or stdin
+ *
+ * A failing input is shrunk a byte range at a time and printed as a C
+ * string, ready for the regressions table in test.c.
+ *
+ * Usage: glyph-fuzz [-n count] [-s seed]    generate and check
+ *        glyph-fuzz file... | -               check the given inputs
+ */
+
+#define GLYPH_IMPL
+#include "../glyph.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MEM_SIZE  256
+#define MAX_STEPS 5000
+#define STACK_DEPTH 16
+
+enum { ENG_REF, ENG_DECODED, ENG_SLICED, ENG_JIT, ENGINES };
+static const char *engine_name[ENGINES] = { "reference", "decoded", "sliced", "jit" };
+
+/* What the host saw: a hash over every port access, in order */
+typedef struct {
+    u32 trace, reads;
+} Io;
+
+typedef struct {
+    Glyph vm;
+    u8 mem[MEM_SIZE];
+    GlyphOp code[MEM_SIZE];
+    u32 stk[STACK_DEPTH];
+    Io io;
+    GlyphStatus st;
+} Run;
+
+static Run runs[ENGINES];
+static u32 rng_state = 1;
+
+static u32 rng(u32 n) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state % n;
+}
+
+static u32 mix(u32 h, u32 v) {
+    for (int i = 0; i < 4; i++, v >>= 8) h = (h ^ (v & 255)) * 16777619u;
+    return h;
+}
+
+static void fuzz_emit(Glyph *vm, void *user, u8 port) {
+    Io *io = user;
+    io->trace = mix(mix(io->trace, port), vm->port[port]);
+}
+
+/* Reads get a value that depends only on how many came before */
+static void fuzz_sense(Glyph *vm, void *user, u8 port) {
+    Io *io = user;
+    io->trace = mix(io->trace, 0x100 | port);
+    vm->port[port] = ++io->reads * 2654435761u;
+}
+
+/* Returns false if the engine is not available in this build */
+static bool run(Run *r, int engine, const u8 *data, size_t len) {
+    memset(r->mem, 0, MEM_SIZE);
+    memcpy(r->mem, data, len < MEM_SIZE ? len : MEM_SIZE);
+    glyph_init(&r->vm, r->mem, MEM_SIZE);
+    glyph_stack(&r->vm, r->stk, STACK_DEPTH);
+    r->io = (Io){ 2166136261u, 0 };
+    r->vm.emit = fuzz_emit;
+    r->vm.sense = fuzz_sense;
+    r->vm.user = &r->io;
+    if (engine != ENG_REF) glyph_predecode(&r->vm, r->code);
+
+    switch (engine) {
+    case ENG_REF:
+    case ENG_DECODED:
+        r->st = glyph_run_for(&r->vm, MAX_STEPS);
+        break;
+    case ENG_SLICED: {
+        u32 seed = rng_state;
+        rng_state = len * 2654435761u | 1;
+        do {
+            u64 slice = 1 + rng(7), left = MAX_STEPS - r->vm.steps;
+            r->st = glyph_run_for(&r->vm, slice < left ? slice : left);
+        } while (r->st == GLYPH_BUDGET && r->vm.steps < MAX_STEPS);
+        rng_state = seed;
+        break;
+    }
+    case ENG_JIT: {
+#ifdef GLYPH_JIT
+        static GlyphJit jit;
+        if (glyph_jit_init(&r->vm, &jit, 0) < 0) return false;
+        jit.hot = 1;
+        r->st = glyph_run_for(&r->vm, MAX_STEPS);
+        glyph_jit_free(&r->vm, &jit);
+        break;
+#else
+        return false;
+#endif
+    }
+    }
+    return true;
+}
+
+/* First field where b differs from the reference a, or NULL */
+static const char *differ(const Run *a, const Run *b) {
+    if (a->st != b->st) return "status";
+    if (a->vm.steps != b->vm.steps) return "steps";
+    if (a->vm.halt != b->vm.halt || a->vm.trap != b->vm.trap) return "halt/trap";
+    if (memcmp(a->vm.reg, b->vm.reg, sizeof(a->vm.reg))) return "registers";
+    if (memcmp(a->mem, b->mem, MEM_SIZE)) return "memory";
+    if (memcmp(a->vm.port, b->vm.port, sizeof(a->vm.port))) return "ports";
+    if (a->io.trace != b->io.trace || a->io.reads != b->io.reads) return "port traffic";
+    if (a->vm.sp != b->vm.sp) return "sp";
+    if (memcmp(a->vm.stk, b->vm.stk, a->vm.sp * sizeof(u32))) return "stack";
+    return NULL;
+}
+
+/* Run every engine; on a mismatch name it and the field, else NULL */
+static const char *check(const u8 *data, size_t len, int *engine) {
+    run(&runs[ENG_REF], ENG_REF, data, len);
+    for (int e = ENG_REF + 1; e < ENGINES; e++) {
+        if (!run(&runs[e], e, data, len)) continue;
+        const char *what = differ(&runs[ENG_REF], &runs[e]);
+        if (what) { *engine = e; return what; }
+    }
+    return NULL;
+}
+
+static void report(const Run *a, const Run *b, const char *what) {
+    fprintf(stderr, "%s differs: %s vs reference\n", what, engine_name[b - runs]);
+    fprintf(stderr, "  steps %lu/%lu  pc %u/%u  sp %u/%u  halt %d/%d  trap %d/%d\n",
+            (unsigned long)b->vm.steps, (unsigned long)a->vm.steps,
+            b->vm.reg['.'], a->vm.reg['.'], b->vm.sp, a->vm.sp,
+            b->vm.halt, a->vm.halt, b->vm.trap, a->vm.trap);
+    for (int i = 0; i < 128; i++)
+        if (a->vm.reg[i] != b->vm.reg[i])
+            fprintf(stderr, "  reg '%c' %u/%u\n", isgraph(i) ? i : '?',
+                    b->vm.reg[i], a->vm.reg[i]);
+    for (int i = 0; i < MEM_SIZE; i++)
+        if (a->mem[i] != b->mem[i])
+            fprintf(stderr, "  mem 0x%02x %u/%u\n", i, b->mem[i], a->mem[i]);
+}
+
+/* Drop byte ranges while the input keeps failing */
+static size_t shrink(u8 *data, size_t len) {
+    int e;
+    for (size_t k = 8; k; k /= 2)
+        for (size_t i = 0; i + k <= len;) {
+            u8 save[8];
+            memcpy(save, data + i, k);
+            memmove(data + i, data + i + k, len - i - k);
+            if (check(data, len - k, &e)) { len -= k; continue; }
+            memmove(data + i + k, data + i, len - i - k);
+            memcpy(data + i, save, k);
+            i++;
+        }
+    return len;
+}
+
+static void print_c(const u8 *data, size_t len) {
+    printf("    \"");
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == '"' || data[i] == '\\') printf("\\%c", data[i]);
+        else if (isprint(data[i])) putchar(data[i]);
+        else printf("\\x%02x\"\"", data[i]);
+    }
+    printf("\",\n");
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    int e;
+    const char *what = check(data, size, &e);
+    if (what) {
+        report(&runs[ENG_REF], &runs[e], what);
+        abort();
+    }
+    return 0;
+}
+
+#ifndef GLYPH_LIBFUZZER
+
+static char *emit_str(char *s, const char *fmt, char x, char y) {
+    return s + sprintf(s, fmt, x, y);
+}
+
+/* A random program of well-formed runes: a counted loop around a body
+ * of arithmetic, immediates, memory, bulk memory and port traffic, leaps,
+ * calls and skips */
+static size_t generate(u8 *out) {
+    static const char *alu = "+-*/%&|^<>", *cond = ".=!><", *reg = "abcdkLF?.1z";
+    char *p = (char *)out, *end = p + MEM_SIZE - 48;  /* room to close */
+    p += sprintf(p, ":011 :0k%x 'L ", 1 + rng(15));
+    int open = 0;
+    char blocks[8], kinds[8];
+    while (p < end) {
+        char d = reg[rng(9)], x = reg[rng(11)], y = reg[rng(11)];
+        switch (rng(22)) {
+        case 0: case 1: case 2:
+            p += sprintf(p, "%c%c%c%c ", alu[rng(10)], d, x, y); break;
+        case 3: p = emit_str(p, "~%c%c ", d, x); break;
+        case 4: p = emit_str(p, ":.%c%c ", d, x); break;
+        case 5: p += sprintf(p, ":0%c%x ", d, rng(16)); break;
+        case 6: p += sprintf(p, ":'%c%c ", d, 33 + rng(94)); break;
+        case 7: p += sprintf(p, "@%c%c%c ", "<hw"[rng(3)], d, x); break;
+        case 8: p += sprintf(p, "@%c%c%c ", ">HW"[rng(3)], x, y); break;
+        case 9: p = emit_str(p, "?%c%c ", x, y); break;
+        case 10: p += sprintf(p, "'%c ", d); break;
+        case 11: p += sprintf(p, ".%c%c ", cond[rng(5)], "LFab"[rng(4)]); break;
+        case 12: p += sprintf(p, ";%c ", "FLa"[rng(3)]); break;
+        case 13: p += sprintf(p, ", "); break;
+        case 14: p = emit_str(p, "#>%c%c ", x, y); break;
+        case 15: p = emit_str(p, "#<%c%c ", d, x); break;
+        case 16:
+            if (open == 8) break;
+            blocks[open] = "ABCF"[rng(4)];
+            kinds[open] = rng(2);
+            if (kinds[open]) p += sprintf(p, "{%c ", blocks[open]);
+            else p += sprintf(p, "[%c%c ", "=!><"[rng(4)], blocks[open]);
+            open++;
+            break;
+        case 17:
+            if (!open) break;
+            open--;
+            p += sprintf(p, "%c%c ", kinds[open] ? '}' : ']', blocks[open]);
+            break;
+        case 18: *p++ = rng(256); break;
+        case 19: *p++ = ' '; break;
+        case 20: p += sprintf(p, "$%c%c%c%c ", ".=?"[rng(3)], x, y, reg[rng(11)]); break;
+        case 21:
+            if (rng(2)) p += sprintf(p, "=%c%c%c%x ", "+-&<>"[rng(5)], d, x, rng(16));
+            else p += sprintf(p, "!%c%c%c%c ", "+-&<>"[rng(5)], d, x, 33 + rng(94));
+            break;
+        }
+    }
+    while (open--) p += sprintf(p, "%c%c ", kinds[open] ? '}' : ']', blocks[open]);
+    p += sprintf(p, "-kk1 ?kz .!L");
+    return p - (char *)out;
+}
+
+static int check_file(const char *path) {
+    static u8 data[1 << 16];
+    FILE *f = strcmp(path, "-") ? fopen(path, "rb") : stdin;
+    if (!f) {
+        fprintf(stderr, "Error: cannot open '%s'\n", path);
+        return 1;
+    }
+    size_t len = fread(data, 1, sizeof(data), f);
+    if (f != stdin) fclose(f);
+    return LLVMFuzzerTestOneInput(data, len);
+}
+
+int main(int argc, char **argv) {
+    unsigned long count = 100000;
+    u32 seed = 1;
+    int i = 1;
+
+    for (; i + 1 < argc && argv[i][0] == '-' && argv[i][1]; i += 2) {
+        if      (!strcmp(argv[i], "-n")) count = strtoul(argv[i + 1], NULL, 0);
+        else if (!strcmp(argv[i], "-s")) seed = strtoul(argv[i + 1], NULL, 0);
+        else break;
+    }
+    if (i < argc) {
+        for (; i < argc; i++)
+            if (check_file(argv[i])) return 1;
+        return 0;
+    }
+
+    rng_state = seed ? seed : 1;
+    for (unsigned long n = 0; n < count; n++) {
+        u8 prog[MEM_SIZE];
+        int e;
+        size_t len = generate(prog);
+        const char *what = check(prog, len, &e);
+        if (!what) continue;
+        fprintf(stderr, "program %lu (seed %u):\n", n, seed);
+        report(&runs[ENG_REF], &runs[e], what);
+        len = shrink(prog, len);
+        check(prog, len, &e);
+        fprintf(stderr, "shrunk to %zu bytes, %s differs under %s:\n", len, what,
+                engine_name[e]);
+        print_c(prog, len);
+        return 1;
+    }
+    printf("%lu programs, all engines agree\n", count);
+    return 0;
+}
+
+#endif /* GLYPH_LIBFUZZER */
@@ -0,0 +1,172 @@
+/*
+ * glyph-ngram - Most frequent rune sequences in a running program
+ *
+ * Steps a program one rune at a time and counts every run of n executed
+ * runes by shape: the rune plus its mode byte, registers left out
+ * (":'" "#>" "?" ".="). Whitespace is skipped, as the fuser does. The top
+ * sequences are the candidates for superinstructions (glyph_fuse in
+ * glyph.h). Each executed sequence is also predecoded where it starts: when
+ * glyph_fuse turns exactly those runes into one slot, that run counts as
+ * fused. Sequences that always fuse are marked, and ones that only fuse
+ * sometimes, like literal chains whose values vary, show how often.
+ *
+ * Usage: glyph-ngram [-n max_n] [-t top] [-s max_steps] <program.glyph> [input]
+ */
+
+#define GLYPH_IMPL
+#include "../glyph.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MEM_SIZE   0x10000
+#define MAX_N      6
+#define TABLE_SIZE (1 << 16)   /* distinct n-grams kept, all n together */
+
+typedef struct {
+    char key[MAX_N * 3];
+    u64 count, fused;  /* runs, and those glyph_fuse makes one slot */
+} Gram;
+
+/* An executed rune: its shape and the bytes it spans */
+typedef struct {
+    char shape[3];
+    u32 pc, end;
+} Rune;
+
+static Glyph vm;
+static Glyph dec;  /* decodes over the same memory, never runs */
+static u8 mem[MEM_SIZE];
+static GlyphOp code[MEM_SIZE];
+static Gram table[TABLE_SIZE];
+static u32 used;
+static const char *in_pos = "";
+
+static void ngram_sense(Glyph *g, void *user, u8 port) {
+    (void)user;
+    if (port == 'c')
+        g->port['c'] = *in_pos ? (u8)*in_pos++ : 0;
+}
+
+/* Shape of the rune at pc: itself, plus the mode byte if it has one */
+static void shape(u32 pc, char *out) {
+    u8 op = mem[pc];
+    out[0] = op; out[1] = 0;
+    if (strchr(":@#.[", op) && pc + 1 < MEM_SIZE && isgraph(mem[pc + 1])) {
+        out[1] = mem[pc + 1]; out[2] = 0;
+    }
+}
+
+static void count(const char *key, bool fused) {
+    u32 h = 2166136261u;
+    for (const char *p = key; *p; p++) h = (h ^ (u8)*p) * 16777619u;
+    for (u32 i = h % TABLE_SIZE;; i = (i + 1) % TABLE_SIZE) {
+        if (!table[i].count) {
+            if (used == TABLE_SIZE - 1) return;  /* full: drop new grams */
+            strcpy(table[i].key, key);
+            used++;
+        }
+        if (strcmp(table[i].key, key) == 0) {
+            table[i].count++;
+            table[i].fused += fused;
+            return;
+        }
+    }
+}
+
+static int by_count(const void *a, const void *b) {
+    u64 x = ((const Gram *)a)->count, y = ((const Gram *)b)->count;
+    return (x < y) - (x > y);
+}
+
+/* Does glyph_fuse turn the runes in [pc, end) into one slot, as memory is
+ * now? Decoded afresh each time, so values and rewrites count. */
+static bool fused(u32 pc, u32 end) {
+    glyph_decode(&dec, pc);
+    return code[pc].op >= OP_CJEQ && pc + code[pc].len == end;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-n max_n] [-t top] [-s max_steps] "
+            "<program.glyph> [input]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    int max_n = 3, top = 15;
+    u64 max_steps = 100000000;
+    int i = 1;
+
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        if      (!strcmp(argv[i], "-n")) max_n = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-t")) top = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-s")) max_steps = strtoull(argv[i + 1], NULL, 0);
+        else break;
+    }
+    if (i >= argc || max_n < 2 || max_n > MAX_N || top < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (i + 1 < argc) in_pos = argv[i + 1];
+
+    FILE *f = fopen(argv[i], "rb");
+    if (!f) {
+        fprintf(stderr, "Error: cannot open '%s'\n", argv[i]);
+        return 1;
+    }
+    size_t len = fread(mem, 1, MEM_SIZE, f);
+    fclose(f);
+    if (!len) {
+        fprintf(stderr, "Error: empty file '%s'\n", argv[i]);
+        return 1;
+    }
+
+    glyph_init(&vm, mem, MEM_SIZE);
+    vm.sense = ngram_sense;
+    glyph_init(&dec, mem, MEM_SIZE);
+    glyph_predecode(&dec, code);
+
+    /* Ring of the last max_n runes */
+    Rune ring[MAX_N];
+    u64 runes = 0;
+    while (vm.steps < max_steps && !vm.halt) {
+        u32 pc = vm.reg['.'];
+        if (pc < MEM_SIZE && !isspace(mem[pc])) {
+            Rune *r = &ring[runes % max_n];
+            GlyphOp o;
+            glyph_decode_at(&dec, pc, &o);
+            shape(pc, r->shape);
+            r->pc = pc;
+            r->end = pc + (o.len ? o.len : 1);
+            runes++;
+            for (int n = 2; n <= max_n && (u64)n <= runes; n++) {
+                char key[MAX_N * 3] = "";
+                for (u64 k = runes - n; k < runes; k++) {
+                    if (k != runes - n) strcat(key, " ");
+                    strcat(key, ring[k % max_n].shape);
+                }
+                count(key, fused(ring[(runes - n) % max_n].pc, r->end));
+            }
+        }
+        glyph_run_for(&vm, 1);
+    }
+
+    qsort(table, TABLE_SIZE, sizeof(Gram), by_count);
+    printf("%lu runes executed (%lu steps)%s\n", (unsigned long)runes,
+           (unsigned long)vm.steps, vm.halt ? "" : ", stopped at -s limit");
+    for (int n = 2; n <= max_n; n++) {
+        printf("\n%d-grams:\n", n);
+        int shown = 0;
+        for (u32 k = 0; k < TABLE_SIZE && shown < top && table[k].count; k++) {
+            int words = 1;
+            for (const char *p = table[k].key; *p; p++) words += *p == ' ';
+            if (words != n) continue;
+            const Gram *g = &table[k];
+            printf("  %12lu  %5.1f%%  %s", (unsigned long)g->count,
+                   100.0 * g->count / runes, g->key);
+            if (g->fused == g->count) printf("  (fused)");
+            else if (g->fused) printf("  (fused %.1f%%)", 100.0 * g->fused / g->count);
+            printf("\n");
+            shown++;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * glyph-sched-bench - Throughput of the multi-VM scheduler
+ *
+ * Boots many independent VMs, each with its own memory and decode cache,
+ * and runs them all through glyph-sched.h with 1, 2, 4 ... N threads.
+ * Guests loop for uneven lengths so idle workers have to steal.
+ *
+ * Usage: glyph-sched-bench [max_threads] [vms] [slice]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define GLYPH_IMPL
+#define GLYPH_SCHED_IMPL
+#include "../glyph-sched.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define VM_MEM 1024
+
+/* a = 3 * k, counting k down to zero */
+static const char *prog = ":011 :0b3 'L +aab -kk1 ?kz .!L";
+
+typedef struct {
+    Glyph vm;
+    u8 mem[VM_MEM];
+    GlyphOp code[VM_MEM];
+} Guest;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static u32 work(int i) {
+    return 2000 + (u32)(i % 97) * 400;
+}
+
+static void boot(Guest *g, int i) {
+    glyph_init(&g->vm, g->mem, VM_MEM);
+    memset(g->mem, 0, VM_MEM);
+    memcpy(g->mem, prog, strlen(prog));
+    glyph_predecode(&g->vm, g->code);
+    g->vm.reg['k'] = work(i);
+}
+
+int main(int argc, char **argv) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_threads = argc > 1 ? atoi(argv[1]) : (ncpu > 0 ? (int)ncpu : 1);
+    int nvms = argc > 2 ? atoi(argv[2]) : 4096;
+    u64 slice = argc > 3 ? strtoull(argv[3], NULL, 10) : 10000;
+    double base = 0;
+
+    Guest *guests = malloc((size_t)nvms * sizeof(Guest));
+    if (!guests || max_threads < 1 || nvms < 1 || !slice) {
+        fprintf(stderr, "Error: bad arguments or out of memory\n");
+        return 1;
+    }
+
+    printf("%d VMs, slice %lu steps, %ld CPUs online\n",
+           nvms, (unsigned long)slice, ncpu);
+    printf("threads  wall(s)   Minstr/s   VMs/s      speedup  steals\n");
+
+    for (int n = 1;; n = (n * 2 < max_threads) ? n * 2 : max_threads) {
+        GlyphSched s;
+        if (glyph_sched_init(&s, n, slice) < 0) {
+            fprintf(stderr, "Error: cannot start %d workers\n", n);
+            return 1;
+        }
+        for (int i = 0; i < nvms; i++) {
+            boot(&guests[i], i);
+            glyph_sched_add(&s, &guests[i].vm);
+        }
+
+        double t0 = now();
+        glyph_sched_run(&s);
+        double t = now() - t0;
+
+        u64 steps = 0, steals = 0;
+        for (int i = 0; i < nvms; i++) {
+            Glyph *vm = &guests[i].vm;
+            if (vm->reg['a'] != 3 * work(i) || vm->trap) {
+                fprintf(stderr, "Error: VM %d ended in a wrong state\n", i);
+                return 1;
+            }
+            steps += vm->steps;
+        }
+        for (int i = 0; i < n; i++)
+            steals += s.worker[i].steals;
+        if (n == 1) base = t;
+
+        printf("%-8d %-9.3f %-10.1f %-10.0f %-8.2f %lu\n", n, t,
+               steps / t / 1e6, nvms / t, base / t, (unsigned long)steals);
+        glyph_sched_free(&s);
+        if (n == max_threads) break;
+    }
+
+    free(guests);
+    return 0;
+}
@@ -5,11 +5,11 @@
  * 
  * Usage:
  *   GlyphAsm g;
- *   glyph_init_asm(&g, buffer, sizeof(buffer));
+ *   glyph_init_asm(&g, NULL, 0);  // or a fixed buffer and its size
  *   
  *   // Emit instructions
- *   G_LOAD_HEX(&g, 'a', 5);      // :ax5
- *   G_LOAD_LIT(&g, 'b', 'H');    // :bgH
+ *   G_LOAD_HEX(&g, 'a', 5);      // :0a5
+ *   G_LOAD_LIT(&g, 'b', 'H');    // :'bH
  *   G_ADD(&g, 'c', 'a', 'b');    // +cab
  *   
  *   // Labels
@@ -17,54 +17,127 @@
  *   G_READ_PORT(&g, 'v', 'p');   // #<vp
  *   G_JUMP_LABEL(&g, "loop");    // Emits code to jump to "loop"
  *   
+ *   glyph_optimize(&g, NULL);    // Optional peephole pass
  *   glyph_resolve(&g);           // Fix up label addresses
  *   glyph_write(&g, "out.glyph");
+ *   glyph_free_asm(&g);
+ *
+ * Labels live in a hash table and names in an arena, so lookups are O(1)
+ * and there is no limit on labels or references. Without a buffer the
+ * assembler owns one that doubles as needed; a fixed buffer that fills up
+ * makes glyph_resolve and glyph_write fail instead of truncating.
+ *
+ * Immediate loads pick the shortest rune sequence for their value. Label
+ * loads start at the longest form and glyph_resolve shrinks them once the
+ * addresses are known, moving the code after them, so G_HERE is only final
+ * after resolving; take addresses through labels instead.
+ *
+ * Runes are emitted, measured and read back as ../glyph-ops.h lays them
+ * out, the same table the VM decodes with.
  */
 
 #ifndef GLYPHC_H
 #define GLYPHC_H
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-
-#define GLYPH_MAX_LABELS 128
-#define GLYPH_MAX_REFS   256
+#include "../glyph-ops.h"
 
 typedef struct {
-    char name[32];
+    const char *name;   /* In the name arena */
     uint32_t addr;
 } GlyphLabel;
 
 typedef struct {
-    char name[32];
-    uint32_t addr;      /* Address where the 16-bit value should go */
-    char reg;           /* Register to load the address into */
+    const char *name;
+    uint32_t addr;      /* Where the load (or data word) starts */
+    uint32_t target;    /* Label address, set by glyph_resolve */
+    char reg;           /* Register to load the address into, 0 = data word */
+    uint8_t len, max;   /* Bytes the load takes now, and reserved */
+    uint8_t pinned;     /* Grew back during relaxation; stays at max */
 } GlyphLabelRef;
 
+/* Bytes [start, end) that are data, not code */
+typedef struct {
+    uint32_t start, end;
+} GlyphRange;
+
+/* Name arena: chunks that never move, so names can be pointed at */
+typedef struct GlyphChunk {
+    struct GlyphChunk *next;
+    uint32_t used, cap;
+    char data[];
+} GlyphChunk;
+
 typedef struct {
     uint8_t *buf;
     uint32_t size;
     uint32_t pos;
+    int owned;              /* buf is ours to grow and free */
+    uint32_t dropped;       /* Bytes past the end of a fixed buffer */
+    
+    GlyphLabel *labels;     /* In definition order */
+    int label_count, label_cap;
+    uint32_t *index;        /* Open addressing: label number + 1, 0 = free */
+    uint32_t index_cap;     /* Power of two, kept at most half full */
+    
+    GlyphLabelRef *refs;
+    int ref_count, ref_cap;
+    
+    GlyphChunk *names;
+    const char *dup;        /* First label defined twice */
+    int oom;                /* An allocation failed; resolve reports it */
     
-    GlyphLabel labels[GLYPH_MAX_LABELS];
-    int label_count;
+    uint32_t const_val[128];    /* Registers pinned by G_CONST */
+    uint32_t const_pos[128];    /* Where each takes hold */
+    uint8_t const_known[128];
     
-    GlyphLabelRef refs[GLYPH_MAX_REFS];
-    int ref_count;
+    GlyphRange *data;           /* In address order, for glyph_optimize */
+    int data_count, data_cap;
 } GlyphAsm;
 
-/* Initialize assembler */
+/* Initialize assembler; buf NULL means allocate and grow as needed */
 static inline void glyph_init_asm(GlyphAsm *g, uint8_t *buf, uint32_t size) {
     memset(g, 0, sizeof(*g));
     g->buf = buf;
-    g->size = size;
+    g->size = buf ? size : 0;
     g->pos = 0;
+    g->owned = !buf;
+}
+
+/* Release the label table, references and names */
+static inline void glyph_free_asm(GlyphAsm *g) {
+    while (g->names) {
+        GlyphChunk *next = g->names->next;
+        free(g->names);
+        g->names = next;
+    }
+    free(g->labels);
+    free(g->index);
+    free(g->refs);
+    free(g->data);
+    g->data = NULL; g->data_count = g->data_cap = 0;
+    if (g->owned) { free(g->buf); g->buf = NULL; g->size = g->pos = 0; }
+    g->labels = NULL; g->index = NULL; g->refs = NULL;
+    g->label_count = g->label_cap = g->ref_count = g->ref_cap = 0;
+    g->index_cap = 0;
+}
+
+/* Make room for one more byte: double an owned buffer, else count a drop */
+static inline int glyph_reserve(GlyphAsm *g) {
+    uint32_t size = g->size ? g->size * 2 : 4096;
+    uint8_t *buf = (g->owned && size > g->size) ? realloc(g->buf, size) : NULL;
+    if (!buf) { g->dropped++; return 0; }
+    g->buf = buf;
+    g->size = size;
+    return 1;
 }
 
 /* Emit a single byte */
 static inline void G_EMIT(GlyphAsm *g, uint8_t b) {
-    if (g->pos < g->size) g->buf[g->pos++] = b;
+    if (g->pos < g->size || glyph_reserve(g)) g->buf[g->pos++] = b;
 }
 
 /* Current address (with base offset) */
@@ -72,71 +145,201 @@ static inline uint32_t G_HERE(GlyphAsm *g) {
     return g->pos;
 }
 
-/* Define a label at current position */
-static inline void G_LABEL(GlyphAsm *g, const char *name) {
-    if (g->label_count < GLYPH_MAX_LABELS) {
-        strncpy(g->labels[g->label_count].name, name, 31);
-        g->labels[g->label_count].addr = G_HERE(g);
-        g->label_count++;
+/* Copy a name into the arena; NULL when out of memory */
+static inline const char *glyph_intern(GlyphAsm *g, const char *name) {
+    uint32_t len = strlen(name) + 1;
+    GlyphChunk *c = g->names;
+    if (!c || c->cap - c->used < len) {
+        uint32_t cap = len > 4096 ? len : 4096;
+        c = malloc(sizeof(GlyphChunk) + cap);
+        if (!c) { g->oom = 1; return NULL; }
+        c->next = g->names; c->used = 0; c->cap = cap;
+        g->names = c;
     }
+    char *s = c->data + c->used;
+    memcpy(s, name, len);
+    c->used += len;
+    return s;
+}
+
+/* Grow an array of n used elements to hold one more; 0 when out of memory */
+static inline int glyph_grow(GlyphAsm *g, void **arr, int n, int *cap, size_t elem) {
+    if (n < *cap) return 1;
+    int ncap = *cap ? *cap * 2 : 64;
+    void *p = realloc(*arr, ncap * elem);
+    if (!p) { g->oom = 1; return 0; }
+    *arr = p; *cap = ncap;
+    return 1;
+}
+
+static inline uint32_t glyph_hash(const char *s) {
+    uint32_t h = 2166136261u;
+    while (*s) h = (h ^ (uint8_t)*s++) * 16777619u;
+    return h;
+}
+
+/* Slot for name in the index: its label, or the free slot it would take */
+static inline uint32_t *glyph_slot(GlyphAsm *g, const char *name) {
+    uint32_t mask = g->index_cap - 1;
+    for (uint32_t i = glyph_hash(name) & mask;; i = (i + 1) & mask)
+        if (!g->index[i] || strcmp(g->labels[g->index[i] - 1].name, name) == 0)
+            return &g->index[i];
+}
+
+/* Find a label; returns 1 and sets *addr if it is defined */
+static inline int glyph_lookup(GlyphAsm *g, const char *name, uint32_t *addr) {
+    if (!g->index_cap) return 0;
+    uint32_t *slot = glyph_slot(g, name);
+    if (!*slot) return 0;
+    *addr = g->labels[*slot - 1].addr;
+    return 1;
 }
 
 /* Find label address (returns 0 if not found) */
 static inline uint32_t glyph_find_label(GlyphAsm *g, const char *name) {
-    for (int i = 0; i < g->label_count; i++) {
-        if (strcmp(g->labels[i].name, name) == 0)
-            return g->labels[i].addr;
+    uint32_t addr = 0;
+    glyph_lookup(g, name, &addr);
+    return addr;
+}
+
+/* Mark n bytes at addr as data, so the optimizer leaves them alone */
+static inline void glyph_mark_data(GlyphAsm *g, uint32_t addr, uint32_t n) {
+    if (g->data_count && g->data[g->data_count - 1].end == addr) {
+        g->data[g->data_count - 1].end += n;
+        return;
     }
-    return 0;
+    if (!glyph_grow(g, (void **)&g->data, g->data_count, &g->data_cap,
+                    sizeof(GlyphRange)))
+        return;
+    g->data[g->data_count].start = addr;
+    g->data[g->data_count++].end = addr + n;
+}
+
+/* Emit a data byte: tables, strings, dictionary headers */
+static inline void G_DATA(GlyphAsm *g, uint8_t b) {
+    glyph_mark_data(g, g->pos, 1);
+    G_EMIT(g, b);
+}
+
+/* Define a label at current position */
+static inline void G_LABEL(GlyphAsm *g, const char *name) {
+    if (2 * (uint32_t)(g->label_count + 1) > g->index_cap) {
+        uint32_t cap = g->index_cap ? g->index_cap * 2 : 256;
+        uint32_t *index = calloc(cap, sizeof(uint32_t));
+        if (!index) { g->oom = 1; return; }
+        free(g->index);
+        g->index = index;
+        g->index_cap = cap;
+        for (int i = 0; i < g->label_count; i++)
+            *glyph_slot(g, g->labels[i].name) = i + 1;
+    }
+    uint32_t *slot = glyph_slot(g, name);
+    if (*slot) {
+        if (!g->dup) g->dup = g->labels[*slot - 1].name;
+        return;
+    }
+    const char *s = glyph_intern(g, name);
+    if (!s || !glyph_grow(g, (void **)&g->labels, g->label_count, &g->label_cap,
+                          sizeof(GlyphLabel)))
+        return;
+    g->labels[g->label_count].name = s;
+    g->labels[g->label_count].addr = G_HERE(g);
+    *slot = ++g->label_count;
 }
 
 /* ─────────────────────────────────────────────────────────────────────────
  * Basic Instructions
  * ───────────────────────────────────────────────────────────────────────── */
 
-/* :agX - Load literal byte into register */
+/* :'aX - Load literal byte into register */
 static inline void G_LOAD_LIT(GlyphAsm *g, char reg, uint8_t val) {
-    G_EMIT(g, ':'); G_EMIT(g, reg); G_EMIT(g, 'g'); G_EMIT(g, val);
+    G_EMIT(g, ':'); G_EMIT(g, '\''); G_EMIT(g, reg); G_EMIT(g, val);
 }
 
-/* :axN - Load hex digit (0-15) into register */
+/* :0aN - Load hex digit (0-15) into register */
 static inline void G_LOAD_HEX(GlyphAsm *g, char reg, uint8_t hex) {
-    G_EMIT(g, ':'); G_EMIT(g, reg); G_EMIT(g, 'x');
+    G_EMIT(g, ':'); G_EMIT(g, '0'); G_EMIT(g, reg);
     G_EMIT(g, (hex < 10) ? ('0' + hex) : ('a' + hex - 10));
 }
 
-/* :a.b - Copy register b to a */
+/* :.ab - Copy register b to a */
 static inline void G_COPY(GlyphAsm *g, char dst, char src) {
-    G_EMIT(g, ':'); G_EMIT(g, dst); G_EMIT(g, '.'); G_EMIT(g, src);
+    G_EMIT(g, ':'); G_EMIT(g, '.'); G_EMIT(g, dst); G_EMIT(g, src);
+}
+
+#define GLYPH_IMM_MAX 34     /* Longest sequence glyph_imm produces */
+
+static inline char glyph_hexc(uint8_t hex) {
+    return (hex < 10) ? ('0' + hex) : ('a' + hex - 10);
+}
+
+static inline uint8_t *glyph_put4(uint8_t *p, char a, char b, char c, char d) {
+    p[0] = a; p[1] = b; p[2] = c; p[3] = d;
+    return p + 4;
 }
 
-/* Load 16-bit immediate into register (12 bytes) */
+/* :0Rh or :'RX, whichever holds the byte */
+static inline uint8_t *glyph_put_byte(uint8_t *p, char reg, uint8_t b) {
+    return b < 16 ? glyph_put4(p, ':', '0', reg, glyph_hexc(b))
+                  : glyph_put4(p, ':', '\'', reg, b);
+}
+
+/* =oabh or !oabX: a = b o byte, whichever holds the byte */
+static inline uint8_t *glyph_put_opi(uint8_t *p, char op, char a, char b, uint8_t byte) {
+    p = glyph_put4(p, byte < 16 ? '=' : '!', op, a, b);
+    *p = byte < 16 ? glyph_hexc(byte) : byte;
+    return p + 1;
+}
+
+/* Shortest sequence loading val into reg, written to out; returns its
+ * length. same names a register already holding val, or 0. The lower
+ * bytes are shifted and added in with immediate runes, so no other
+ * register is touched and the VM runs a 16-bit load as one fused LITS
+ * slot. */
+static inline uint32_t glyph_imm(uint8_t *out, char reg, uint32_t val, char same) {
+    int top = val > 0xFFFFFF ? 3 : val > 0xFFFF ? 2 : val > 0xFF ? 1 : 0, shift = 0;
+    uint8_t *p = out;
+    if (same && top) return glyph_put4(p, ':', '.', reg, same) - out;
+    p = glyph_put_byte(p, reg, val >> 8 * top);
+    for (int i = top - 1; i >= 0; i--) {
+        uint8_t b = val >> 8 * i;
+        shift += 8;
+        if (!b) continue;
+        p = glyph_put_opi(p, '<', reg, reg, shift);
+        p = glyph_put_opi(p, '+', reg, reg, b);
+        shift = 0;
+    }
+    if (shift) p = glyph_put_opi(p, '<', reg, reg, shift);
+    return p - out;
+}
+
+/* A pinned register other than reg holding val, or 0 */
+static inline char glyph_const_reg(GlyphAsm *g, char reg, uint32_t val) {
+    for (int r = 0; r < 128; r++)
+        if (g->const_known[r] && g->const_val[r] == val && r != (reg & 127))
+            return r;
+    return 0;
+}
+
+/* Load any 32-bit immediate in as few bytes as it takes (4 to 34) */
+static inline void G_LOAD_IMM(GlyphAsm *g, char reg, uint32_t val) {
+    uint8_t seq[GLYPH_IMM_MAX];
+    uint32_t n = glyph_imm(seq, reg, val, glyph_const_reg(g, reg, val));
+    for (uint32_t i = 0; i < n; i++) G_EMIT(g, seq[i]);
+}
+
+/* Load 16-bit immediate into register (4 to 14 bytes) */
 static inline void G_LOAD16(GlyphAsm *g, char reg, uint16_t val) {
-    uint8_t hh = (val >> 12) & 0xF;
-    uint8_t hl = (val >> 8) & 0xF;
-    uint8_t lh = (val >> 4) & 0xF;
-    uint8_t ll = val & 0xF;
-    
-    /* Use temp registers: reg for high byte build, '~' for low byte build */
-    /* Build: ((hh << 4) | hl) << 8 | ((lh << 4) | ll) */
-    
-    /* High byte into reg */
-    G_LOAD_HEX(g, reg, hh);           /* :Rxhh */
-    G_EMIT(g, '<'); G_EMIT(g, reg); G_EMIT(g, reg); G_EMIT(g, '4'); /* <RR4 - shift left 4 */
-    G_LOAD_HEX(g, '~', hl);           /* :~xhl */
-    G_EMIT(g, '|'); G_EMIT(g, reg); G_EMIT(g, reg); G_EMIT(g, '~'); /* |RR~ - or with low nibble */
-    
-    /* Shift high byte left 8 */
-    G_EMIT(g, '<'); G_EMIT(g, reg); G_EMIT(g, reg); G_EMIT(g, '8'); /* <RR8 */
-    
-    /* Low byte into temp */
-    G_LOAD_HEX(g, '~', lh);           /* :~xlh */
-    G_EMIT(g, '<'); G_EMIT(g, '~'); G_EMIT(g, '~'); G_EMIT(g, '4'); /* <~~4 */
-    G_LOAD_HEX(g, '_', ll);           /* :_xll */
-    G_EMIT(g, '|'); G_EMIT(g, '~'); G_EMIT(g, '~'); G_EMIT(g, '_'); /* |~~_ */
-    
-    /* Combine */
-    G_EMIT(g, '|'); G_EMIT(g, reg); G_EMIT(g, reg); G_EMIT(g, '~'); /* |RR~ */
+    G_LOAD_IMM(g, reg, val);
+}
+
+/* Load a constant that reg keeps for the rest of the program. Later loads
+ * of the same value copy it. Only pin registers nothing else writes. */
+static inline void G_CONST(GlyphAsm *g, char reg, uint32_t val) {
+    G_LOAD_IMM(g, reg, val);
+    g->const_known[reg & 127] = 1;
+    g->const_val[reg & 127] = val;
+    g->const_pos[reg & 127] = g->pos;
 }
 
 /* ─────────────────────────────────────────────────────────────────────────
@@ -163,6 +366,21 @@ static inline void G_MOD(GlyphAsm *g, char d, char a, char b) {
     G_EMIT(g, '%'); G_EMIT(g, d); G_EMIT(g, a); G_EMIT(g, b);
 }
 
+/* Immediate forms: =+abN for a byte under 16, !+abX for the rest */
+static inline void glyph_opi(GlyphAsm *g, char op, char d, char a, uint8_t imm) {
+    uint8_t seq[5];
+    glyph_put_opi(seq, op, d, a, imm);
+    for (int i = 0; i < 5; i++) G_EMIT(g, seq[i]);
+}
+
+static inline void G_ADDI(GlyphAsm *g, char d, char a, uint8_t imm) {
+    glyph_opi(g, '+', d, a, imm);
+}
+
+static inline void G_SUBI(GlyphAsm *g, char d, char a, uint8_t imm) {
+    glyph_opi(g, '-', d, a, imm);
+}
+
 /* ─────────────────────────────────────────────────────────────────────────
  * Bitwise
  * ───────────────────────────────────────────────────────────────────────── */
@@ -191,18 +409,65 @@ static inline void G_SHR(GlyphAsm *g, char d, char a, char b) {
     G_EMIT(g, '>'); G_EMIT(g, d); G_EMIT(g, a); G_EMIT(g, b);
 }
 
+static inline void G_ANDI(GlyphAsm *g, char d, char a, uint8_t imm) {
+    glyph_opi(g, '&', d, a, imm);
+}
+
+static inline void G_SHLI(GlyphAsm *g, char d, char a, uint8_t imm) {
+    glyph_opi(g, '<', d, a, imm);
+}
+
+static inline void G_SHRI(GlyphAsm *g, char d, char a, uint8_t imm) {
+    glyph_opi(g, '>', d, a, imm);
+}
+
 /* ─────────────────────────────────────────────────────────────────────────
  * Memory
  * ───────────────────────────────────────────────────────────────────────── */
 
-/* @ab - Load from memory: a = mem[b] */
+/* @<ab - Load from memory: a = mem[b] */
 static inline void G_LOAD_MEM(GlyphAsm *g, char dst, char addr) {
-    G_EMIT(g, '@'); G_EMIT(g, dst); G_EMIT(g, addr);
+    G_EMIT(g, '@'); G_EMIT(g, '<'); G_EMIT(g, dst); G_EMIT(g, addr);
 }
 
-/* !ab - Store to memory: mem[a] = b */
+/* @>ab - Store to memory: mem[a] = b */
 static inline void G_STORE_MEM(GlyphAsm *g, char addr, char val) {
-    G_EMIT(g, '!'); G_EMIT(g, addr); G_EMIT(g, val);
+    G_EMIT(g, '@'); G_EMIT(g, '>'); G_EMIT(g, addr); G_EMIT(g, val);
+}
+
+/* @hab - Load 16 bits, little endian: a = mem[b] | mem[b+1] << 8 */
+static inline void G_LOAD16_MEM(GlyphAsm *g, char dst, char addr) {
+    G_EMIT(g, '@'); G_EMIT(g, 'h'); G_EMIT(g, dst); G_EMIT(g, addr);
+}
+
+/* @Hab - Store the low 16 bits of b at a, little endian */
+static inline void G_STORE16_MEM(GlyphAsm *g, char addr, char val) {
+    G_EMIT(g, '@'); G_EMIT(g, 'H'); G_EMIT(g, addr); G_EMIT(g, val);
+}
+
+/* @wab - Load 32 bits, little endian: a = mem[b] | ... | mem[b+3] << 24 */
+static inline void G_LOAD32_MEM(GlyphAsm *g, char dst, char addr) {
+    G_EMIT(g, '@'); G_EMIT(g, 'w'); G_EMIT(g, dst); G_EMIT(g, addr);
+}
+
+/* @Wab - Store all 32 bits of b at a, little endian */
+static inline void G_STORE32_MEM(GlyphAsm *g, char addr, char val) {
+    G_EMIT(g, '@'); G_EMIT(g, 'W'); G_EMIT(g, addr); G_EMIT(g, val);
+}
+
+/* $.abn - Copy n bytes: mem[a..] = mem[b..], as if read before written */
+static inline void G_MOVE_MEM(GlyphAsm *g, char dst, char src, char n) {
+    G_EMIT(g, '$'); G_EMIT(g, '.'); G_EMIT(g, dst); G_EMIT(g, src); G_EMIT(g, n);
+}
+
+/* $=abn - Fill n bytes: mem[a..] = b */
+static inline void G_FILL_MEM(GlyphAsm *g, char dst, char val, char n) {
+    G_EMIT(g, '$'); G_EMIT(g, '='); G_EMIT(g, dst); G_EMIT(g, val); G_EMIT(g, n);
+}
+
+/* $?abn - Compare n bytes at a with n bytes at b into the flags register '?' */
+static inline void G_CMP_MEM(GlyphAsm *g, char a, char b, char n) {
+    G_EMIT(g, '$'); G_EMIT(g, '?'); G_EMIT(g, a); G_EMIT(g, b); G_EMIT(g, n);
 }
 
 /* ─────────────────────────────────────────────────────────────────────────
@@ -223,9 +488,9 @@ static inline void G_WRITE_PORT(GlyphAsm *g, char port, char val) {
  * Control Flow
  * ───────────────────────────────────────────────────────────────────────── */
 
-/* .a - Jump to address in register */
+/* ..a - Leap to address in register */
 static inline void G_JUMP(GlyphAsm *g, char reg) {
-    G_EMIT(g, '.'); G_EMIT(g, reg);
+    G_EMIT(g, '.'); G_EMIT(g, '.'); G_EMIT(g, reg);
 }
 
 /* ;a - Call subroutine at address in register */
@@ -238,98 +503,764 @@ static inline void G_RET(GlyphAsm *g) {
     G_EMIT(g, ',');
 }
 
-/* ?=abt - If a == b, jump to address in t */
+/* 'a - Mark: a = address after the rune, for backward leaps */
+static inline void G_MARK(GlyphAsm *g, char reg) {
+    G_EMIT(g, '\''); G_EMIT(g, reg);
+}
+
+/* ?ab - Compare a with b into the flags register '?' */
+static inline void G_CMP(GlyphAsm *g, char a, char b) {
+    G_EMIT(g, '?'); G_EMIT(g, a); G_EMIT(g, b);
+}
+
+/* .Ct - Leap to t if the flags meet C: '=' '!' '>' '<' ('.' always) */
+static inline void G_LEAP(GlyphAsm *g, char cond, char target) {
+    G_EMIT(g, '.'); G_EMIT(g, cond); G_EMIT(g, target);
+}
+
+/* ?ab .=t - If a == b, leap to address in t */
 static inline void G_JEQ(GlyphAsm *g, char a, char b, char target) {
-    G_EMIT(g, '?'); G_EMIT(g, '='); G_EMIT(g, a); G_EMIT(g, b); G_EMIT(g, target);
+    G_CMP(g, a, b); G_LEAP(g, '=', target);
 }
 
-/* ?!abt - If a != b, jump to address in t */
+/* ?ab .!t - If a != b, leap to address in t */
 static inline void G_JNE(GlyphAsm *g, char a, char b, char target) {
-    G_EMIT(g, '?'); G_EMIT(g, '!'); G_EMIT(g, a); G_EMIT(g, b); G_EMIT(g, target);
+    G_CMP(g, a, b); G_LEAP(g, '!', target);
 }
 
-/* ?>abt - If a > b, jump to address in t */
+/* ?ab .>t - If a > b, leap to address in t */
 static inline void G_JGT(GlyphAsm *g, char a, char b, char target) {
-    G_EMIT(g, '?'); G_EMIT(g, '>'); G_EMIT(g, a); G_EMIT(g, b); G_EMIT(g, target);
+    G_CMP(g, a, b); G_LEAP(g, '>', target);
 }
 
-/* ?<abt - If a < b, jump to address in t */
+/* ?ab .<t - If a < b, leap to address in t */
 static inline void G_JLT(GlyphAsm *g, char a, char b, char target) {
-    G_EMIT(g, '?'); G_EMIT(g, '<'); G_EMIT(g, a); G_EMIT(g, b); G_EMIT(g, target);
+    G_CMP(g, a, b); G_LEAP(g, '<', target);
 }
 
 /* ─────────────────────────────────────────────────────────────────────────
  * Label References (for forward jumps)
  * ───────────────────────────────────────────────────────────────────────── */
 
-/* Reserve space for a label reference (to be resolved later) */
+/* Record a reference to label at the current position */
+static inline GlyphLabelRef *glyph_ref(GlyphAsm *g, const char *label, char reg) {
+    const char *name = glyph_intern(g, label);
+    if (!name || !glyph_grow(g, (void **)&g->refs, g->ref_count, &g->ref_cap,
+                             sizeof(GlyphLabelRef)))
+        return NULL;
+    GlyphLabelRef *r = &g->refs[g->ref_count++];
+    memset(r, 0, sizeof(*r));
+    r->name = name;
+    r->addr = g->pos;
+    r->reg = reg;
+    return r;
+}
+
+/* Load a label's address. Backward references too are resolved late, as
+ * the code in between may still shrink. */
 static inline void G_LOAD16_LABEL(GlyphAsm *g, char reg, const char *label) {
-    /* Check if label is already defined */
-    uint32_t addr = glyph_find_label(g, label);
-    if (addr) {
-        G_LOAD16(g, reg, addr);
-    } else {
-        /* Record reference for later resolution */
-        if (g->ref_count < GLYPH_MAX_REFS) {
-            strncpy(g->refs[g->ref_count].name, label, 31);
-            g->refs[g->ref_count].addr = g->pos;
-            g->refs[g->ref_count].reg = reg;
-            g->ref_count++;
+    uint8_t seq[GLYPH_IMM_MAX];
+    uint32_t n = glyph_imm(seq, reg, 0xFFFF, 0);
+    GlyphLabelRef *r = glyph_ref(g, label, reg);
+    if (r) r->len = r->max = n;
+    /* Emit placeholder (will be patched) */
+    for (uint32_t i = 0; i < n; i++) G_EMIT(g, seq[i]);
+}
+
+/* Emit a label's address as 2 data bytes, little endian */
+static inline void G_DATA16_LABEL(GlyphAsm *g, const char *label) {
+    GlyphLabelRef *r = glyph_ref(g, label, 0);
+    if (r) r->len = r->max = 2;
+    G_DATA(g, 0); G_DATA(g, 0);
+}
+
+/* Where original position p ends up; saved[i] is what refs 0..i-1 shed */
+static inline uint32_t glyph_moved(GlyphAsm *g, const uint32_t *saved, uint32_t p) {
+    int lo = 0, hi = g->ref_count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (g->refs[mid].addr < p) lo = mid + 1;
+        else hi = mid;
+    }
+    return p - saved[lo];
+}
+
+/* Shrink label loads to their targets, then close the gaps. A load whose
+ * target moves to a value needing more bytes goes back to its full size
+ * for good, so the passes always end. */
+static inline int glyph_relax(GlyphAsm *g) {
+    if (!g->ref_count) return 0;
+    uint32_t *saved = calloc(g->ref_count + 1, sizeof(uint32_t));
+    uint8_t seq[GLYPH_IMM_MAX];
+    if (!saved) return -1;
+    for (int changed = 1; changed;) {
+        changed = 0;
+        for (int i = 0; i < g->ref_count; i++)
+            saved[i + 1] = saved[i] + g->refs[i].max - g->refs[i].len;
+        for (int i = 0; i < g->ref_count; i++) {
+            GlyphLabelRef *r = &g->refs[i];
+            if (!r->reg || r->pinned) continue;
+            uint32_t need = glyph_imm(seq, r->reg, glyph_moved(g, saved, r->target), 0);
+            if (need < r->len) { r->len = need; changed = 1; }
+            else if (need > r->len) { r->len = r->max; r->pinned = 1; changed = 1; }
         }
-        /* Emit placeholder (will be patched) */
-        G_LOAD16(g, reg, 0xFFFF);
     }
+    for (int i = 0; i < g->label_count; i++)
+        g->labels[i].addr = glyph_moved(g, saved, g->labels[i].addr);
+    for (int i = 0; i < g->ref_count; i++)
+        g->refs[i].target = glyph_moved(g, saved, g->refs[i].target);
+    for (int i = 0; i < g->data_count; i++) {
+        g->data[i].start = glyph_moved(g, saved, g->data[i].start);
+        g->data[i].end = glyph_moved(g, saved, g->data[i].end);
+    }
+    
+    uint32_t in = 0, out = 0;
+    for (int i = 0; i < g->ref_count; i++) {
+        GlyphLabelRef *r = &g->refs[i];
+        memmove(g->buf + out, g->buf + in, r->addr - in);
+        out += r->addr - in;
+        in = r->addr + r->max;
+        r->addr = out;
+        out += r->len;
+    }
+    memmove(g->buf + out, g->buf + in, g->pos - in);
+    g->pos = out + (g->pos - in);
+    free(saved);
+    return 0;
 }
 
 /* Resolve all label references */
 static inline int glyph_resolve(GlyphAsm *g) {
+    if (g->oom) {
+        fprintf(stderr, "glyphc: out of memory for labels\n");
+        return -1;
+    }
+    if (g->dup) {
+        fprintf(stderr, "glyphc: label '%s' defined twice\n", g->dup);
+        return -1;
+    }
+    if (g->dropped) {
+        fprintf(stderr, "glyphc: output overflows %s buffer of %u bytes by %u\n",
+                g->owned ? "the" : "a fixed", g->size, g->dropped);
+        return -1;
+    }
     for (int i = 0; i < g->ref_count; i++) {
-        uint32_t addr = glyph_find_label(g, g->refs[i].name);
-        if (!addr) {
+        if (!glyph_lookup(g, g->refs[i].name, &g->refs[i].target)) {
             fprintf(stderr, "glyphc: undefined label '%s'\n", g->refs[i].name);
             return -1;
         }
-        
-        /* Patch the G_LOAD16 instruction */
-        uint32_t pos = g->refs[i].addr;
-        char reg = g->refs[i].reg;
-        
-        uint8_t hh = (addr >> 12) & 0xF;
-        uint8_t hl = (addr >> 8) & 0xF;
-        uint8_t lh = (addr >> 4) & 0xF;
-        uint8_t ll = addr & 0xF;
-        
-        /* Patch the hex digits in the instruction sequence */
-        /* :Rxhh<RR4:~xhl|RR~<RR8:~xlh<~~4:_xll|~~_|RR~ */
-        /* pos+0: : pos+1: R pos+2: x pos+3: hh */
-        g->buf[pos + 3] = (hh < 10) ? ('0' + hh) : ('a' + hh - 10);
-        /* pos+8: : pos+9: ~ pos+10: x pos+11: hl */
-        g->buf[pos + 11] = (hl < 10) ? ('0' + hl) : ('a' + hl - 10);
-        /* pos+20: : pos+21: ~ pos+22: x pos+23: lh */
-        g->buf[pos + 23] = (lh < 10) ? ('0' + lh) : ('a' + lh - 10);
-        /* pos+28: : pos+29: _ pos+30: x pos+31: ll */
-        g->buf[pos + 31] = (ll < 10) ? ('0' + ll) : ('a' + ll - 10);
-        
-        /* Also patch the register names */
-        g->buf[pos + 1] = reg;
-        g->buf[pos + 5] = reg;
-        g->buf[pos + 6] = reg;
-        g->buf[pos + 13] = reg;
-        g->buf[pos + 14] = reg;
-        g->buf[pos + 17] = reg;
-        g->buf[pos + 18] = reg;
-        g->buf[pos + 37] = reg;
-        g->buf[pos + 38] = reg;
+    }
+    if (glyph_relax(g) < 0) {
+        fprintf(stderr, "glyphc: out of memory for labels\n");
+        return -1;
+    }
+    for (int i = 0; i < g->ref_count; i++) {
+        GlyphLabelRef *r = &g->refs[i];
+        uint8_t *at = g->buf + r->addr;
+        if (r->target > 0xFFFF) {
+            fprintf(stderr, "glyphc: label '%s' at 0x%X is past 16 bits\n",
+                    r->name, r->target);
+            return -1;
+        }
+        if (!r->reg) {
+            at[0] = r->target & 0xFF;
+            at[1] = r->target >> 8;
+            continue;
+        }
+        /* A pinned load may be longer than it needs: pad with spaces */
+        uint32_t n = glyph_imm(at, r->reg, r->target, 0);
+        memset(at + n, ' ', r->len - n);
     }
     return 0;
 }
 
 /* Write output to file */
 static inline int glyph_write(GlyphAsm *g, const char *path) {
+    if (g->dropped) return -1;
     FILE *f = fopen(path, "wb");
     if (!f) return -1;
-    fwrite(g->buf, 1, g->pos, f);
-    fclose(f);
+    size_t n = fwrite(g->buf, 1, g->pos, f);
+    if (fclose(f) != 0 || n != g->pos) return -1;
+    return 0;
+}
+
+/* ─────────────────────────────────────────────────────────────────────────
+ * Peephole Optimizer
+ *
+ * glyph_optimize rewrites the code emitted so far; run it once, before
+ * glyph_resolve. Code is split into basic blocks at labels and data. Within
+ * a block it tracks which registers hold known constants or label addresses,
+ * and with them it
+ *   - drops loads of a value the register already holds,
+ *   - folds arithmetic and compares on known values, and reloads a folded
+ *     constant directly when that is shorter than the code computing it,
+ *   - turns leaps on known flags into plain leaps, or drops them,
+ *   - threads jumps whose target is just another jump,
+ *   - drops code after an unconditional jump up to the next label,
+ *   - turns arithmetic on a byte known in a register into the immediate
+ *     form where that was the register's last read, so its load goes,
+ *   - drops writes to registers overwritten before they are read.
+ * Registers are live at the end of a block, except the scratch registers
+ * '~' and '_' and the flags '?', which only carry a compare to the leaps
+ * right after it. Marks and skips also end blocks.
+ * Registers pinned with G_CONST are known from where they were loaded on.
+ * G_DATA bytes are never touched.
+ * ───────────────────────────────────────────────────────────────────────── */
+
+enum { GLYPH_I_CODE, GLYPH_I_REF, GLYPH_I_DATA, GLYPH_I_IMM };
+
+typedef struct {
+    uint32_t pos, len;      /* Original bytes; len is the new size */
+    uint32_t to;            /* Address after optimization */
+    uint8_t kind;
+    uint8_t start;          /* Starts a basic block */
+    uint8_t dead;
+    uint8_t rewritten;      /* Code now in rw, len bytes */
+    uint8_t rw[5];
+    uint16_t imm;           /* 1 + the byte an ALU rune's c holds, or 0 */
+    int ref;                /* refs index of a label load */
+    char reg, same;         /* GLYPH_I_IMM: reg = val, as glyph_imm emits */
+    uint32_t val;
+} GlyphItem;
+
+typedef struct {
+    uint8_t kind;           /* 0 unknown, 1 constant, 2 label address */
+    uint32_t val;
+    const char *label;
+    uint32_t cost;          /* Bytes this block spent computing it */
+} GlyphVal;
+
+typedef struct {
+    uint32_t bytes_before, bytes_after;
+    uint32_t insns_before, insns_after;
+} GlyphOptStats;
+
+/* A rune read back through the encoding table */
+typedef struct {
+    uint8_t rune, mode;     /* mode is 0 for runes without one */
+    uint8_t len;            /* 0 if p is not a whole rune */
+    const char *args;       /* Operand letters; NULL for an unknown mode */
+    uint8_t a, b, c;        /* Operands by slot, as the VM decodes them */
+    uint32_t val;           /* A literal or hex digit operand */
+} GlyphRune;
+
+static inline void glyph_read_rune(const uint8_t *p, uint32_t avail, GlyphRune *d) {
+    uint8_t moded = 0, slot[3] = { 0, 0, 0 };
+    memset(d, 0, sizeof(*d));
+    d->rune = p[0];
+    switch (p[0]) {
+#define GLYPH_RUNE(r, l, m) case r: d->len = l; moded = m; break;
+    GLYPH_RUNES(GLYPH_RUNE)
+#undef GLYPH_RUNE
+    }
+    if (d->len > avail) d->len = 0;
+    if (!d->len) return;
+    if (moded) d->mode = p[1];
+    switch (p[0] << 8 | d->mode) {
+#define GLYPH_FORM(r, m, n, ar, t) case (r) << 8 | (m): d->args = ar; break;
+    GLYPH_FORMS(GLYPH_FORM)
+#undef GLYPH_FORM
+    }
+    if (!d->args) return;
+    p += 1 + moded;
+    for (int i = 0; d->args[i]; i++) {
+        if (d->args[i] == 'r') slot[i] = p[i] & 127;
+        else if (d->args[i] == 'n') slot[i] = p[i];
+        else d->val = d->args[i] == 'h' ? GLYPH_HEX(p[i]) : p[i];
+    }
+    d->a = slot[0]; d->b = slot[1]; d->c = slot[2];
+}
+
+/* Register a known rune writes, or 0 */
+static inline uint8_t glyph_rune_writes(const GlyphRune *d) {
+    switch (d->rune) {
+    case '+': case '-': case '*': case '/': case '%':
+    case '&': case '|': case '^': case '<': case '>':
+    case '!': case '=': case '~': case ':': case '\'': return d->a;
+    case '@': return d->mode && strchr("<hw", d->mode) ? d->a : 0;
+    case '#': return d->mode == '<' ? d->a : 0;
+    case '?': return '?';
+    case '$': return d->mode == '?' ? '?' : 0;
+    }
+    return 0;
+}
+
+/* Whether flags f meet the condition of a leap or skip */
+static inline int glyph_cond(uint8_t cond, uint32_t f) {
+    return cond == '.' || (cond == '=' && (f & 1)) || (cond == '!' && !(f & 1)) ||
+           (cond == '>' && (f & 2)) || (cond == '<' && (f & 4));
+}
+
+/* Runes that leaps or skips land next to without a label */
+static inline int glyph_lands(uint8_t rune) {
+    return rune && strchr("'{}[]", rune);
+}
+
+static inline const uint8_t *glyph_item_code(GlyphAsm *g, const GlyphItem *x) {
+    return x->rewritten ? x->rw : g->buf + x->pos;
+}
+
+static inline uint32_t glyph_item_insns(const GlyphItem *x) {
+    if (x->kind == GLYPH_I_DATA) return 0;
+    return x->kind == GLYPH_I_CODE ? 1 : 1 + (x->len - 4) / 5;
+}
+
+static inline void glyph_rewrite(GlyphItem *x, const uint8_t *b, uint32_t n) {
+    memcpy(x->rw, b, n);
+    x->len = n;
+    x->rewritten = 1;
+}
+
+static inline int glyph_same_val(GlyphVal x, GlyphVal y) {
+    return x.kind && x.kind == y.kind &&
+           (x.kind == 1 ? x.val == y.val : strcmp(x.label, y.label) == 0);
+}
+
+static const GlyphVal glyph_unknown = { 0, 0, NULL, 0 };
+
+/* Fold op on known operands; 0 when the VM result is not certain */
+static inline int glyph_fold_alu(uint8_t op, uint32_t x, uint32_t y, uint32_t *r) {
+    switch (op) {
+    case '+': *r = x + y; return 1;
+    case '-': *r = x - y; return 1;
+    case '*': *r = x * y; return 1;
+    case '/': if (!y) return 0; *r = x / y; return 1;
+    case '%': if (!y) return 0; *r = x % y; return 1;
+    case '&': *r = x & y; return 1;
+    case '|': *r = x | y; return 1;
+    case '^': *r = x ^ y; return 1;
+    case '<': *r = x << (y & 31); return 1;
+    case '>': *r = x >> (y & 31); return 1;
+    }
+    return 0;
+}
+
+/* Pinned register (other than reg) holding val by pos, or 0 */
+static inline char glyph_pinned(GlyphAsm *g, char reg, uint32_t val, uint32_t pos) {
+    for (int r = 0; r < 128; r++)
+        if (g->const_known[r] && g->const_val[r] == val && g->const_pos[r] <= pos &&
+            r != (reg & 127))
+            return r;
+    return 0;
+}
+
+/* What is known at the start of a block at address pos */
+static inline void glyph_opt_enter(GlyphAsm *g, GlyphVal *v, uint32_t pos) {
+    for (int r = 0; r < 128; r++) {
+        v[r] = glyph_unknown;
+        if (g->const_known[r] && g->const_pos[r] <= pos)
+            v[r] = (GlyphVal){ 1, g->const_val[r], NULL, 0 };
+    }
+}
+
+static inline void glyph_live_all(uint8_t *live) {
+    memset(live, 1, 128);
+    live['~'] = live['_'] = live['?'] = 0;
+}
+
+/* Index of the item at address pos, or -1 */
+static inline int glyph_item_at(const GlyphItem *it, int n, uint32_t pos) {
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (it[mid].pos < pos) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < n && it[lo].pos == pos ? lo : -1;
+}
+
+/* Next live item after i, or n */
+static inline int glyph_item_next(const GlyphItem *it, int n, int i) {
+    while (++i < n && it[i].dead) {}
+    return i;
+}
+
+/* Follow labels whose code only loads reg with another label and jumps */
+static inline const char *glyph_thread(GlyphAsm *g, GlyphItem *it, int n,
+                                       const char *label, char reg) {
+    for (int hops = 0; hops < 8; hops++) {
+        uint32_t addr;
+        int i, j;
+        if (!glyph_lookup(g, label, &addr) || (i = glyph_item_at(it, n, addr)) < 0)
+            break;
+        if (it[i].dead) i = glyph_item_next(it, n, i);
+        if (i >= n || it[i].kind != GLYPH_I_REF || g->refs[it[i].ref].reg != reg)
+            break;
+        j = glyph_item_next(it, n, i);
+        if (j >= n || it[j].kind != GLYPH_I_CODE || it[j].start) break;
+        const uint8_t *p = glyph_item_code(g, &it[j]);
+        if (it[j].len != 3 || p[0] != '.' || p[1] != '.' || p[2] != reg) break;
+        if (strcmp(g->refs[it[i].ref].name, label) == 0) break;
+        label = g->refs[it[i].ref].name;
+    }
+    return label;
+}
+
+/* reg = r, which cost bytes to compute: rewrite x as the shortest load */
+static inline void glyph_opt_const(GlyphAsm *g, GlyphItem *x, GlyphVal *v,
+                                   char reg, uint32_t r, uint32_t cost) {
+    uint8_t seq[GLYPH_IMM_MAX];
+    char same = glyph_pinned(g, reg, r, x->pos);
+    uint32_t n = glyph_imm(seq, reg, r, same);
+    if (n <= 4) {
+        glyph_rewrite(x, seq, n);
+    } else if (n < cost) {
+        x->kind = GLYPH_I_IMM;
+        x->reg = reg; x->val = r; x->same = same;
+        x->len = n;
+    } else {
+        n = cost;
+    }
+    v[reg & 127] = (GlyphVal){ 1, r, NULL, n };
+}
+
+/* Forward pass: known values, redundant loads, folding, threading */
+static inline int glyph_opt_forward(GlyphAsm *g, GlyphItem *it, int n) {
+    GlyphVal v[128];
+    int changed = 0, unreachable = 0;
+    glyph_opt_enter(g, v, 0);
+    for (int i = 0; i < n; i++) {
+        GlyphItem *x = &it[i];
+        if (x->start) {
+            glyph_opt_enter(g, v, x->pos);
+            unreachable = 0;
+        }
+        if (x->dead || x->kind == GLYPH_I_DATA) continue;
+        if (unreachable) {
+            x->dead = changed = 1;
+            continue;
+        }
+        if (x->kind == GLYPH_I_IMM) {
+            v[x->reg & 127] = (GlyphVal){ 1, x->val, NULL, x->len };
+            continue;
+        }
+        if (x->kind == GLYPH_I_REF) {
+            GlyphLabelRef *r = &g->refs[x->ref];
+            GlyphVal nv = { 2, 0, r->name, x->len };
+            if (glyph_same_val(v[r->reg & 127], nv)) {
+                x->dead = changed = 1;
+                continue;
+            }
+            v[r->reg & 127] = nv;
+            continue;
+        }
+        const uint8_t *p = glyph_item_code(g, x);
+        GlyphRune d;
+        glyph_read_rune(p, x->len, &d);
+        uint8_t seq[4], a = d.a, b = d.b, c = d.c;
+        x->imm = 0;
+        if (d.len != x->len || !d.args) {
+            glyph_opt_enter(g, v, x->pos);      /* Not a rune we know */
+            continue;
+        }
+        if (d.len == 1) {
+            if (d.rune == ',' || d.rune == 0) unreachable = 1;
+            else x->dead = changed = 1;         /* Whitespace */
+            continue;
+        }
+        if (glyph_rune_writes(&d) == '.') {
+            glyph_opt_enter(g, v, x->pos);      /* Writes the PC: leave it be */
+            continue;
+        }
+        switch (d.rune) {
+        case '+': case '-': case '*': case '/': case '%':
+        case '&': case '|': case '^': case '<': case '>':
+        case '!': case '=': {
+            uint32_t r;
+            int imm = d.rune == '!' || d.rune == '=';
+            uint8_t op = imm ? d.mode : d.rune;
+            GlyphVal y = imm ? (GlyphVal){ 1, d.val, NULL, 0 } : v[c];
+            if (v[b].kind == 1 && y.kind == 1 &&
+                glyph_fold_alu(op, v[b].val, y.val, &r)) {
+                if (glyph_same_val(v[a], (GlyphVal){ 1, r, NULL, 0 })) {
+                    x->dead = changed = 1;
+                    break;
+                }
+                uint32_t cost = v[b].cost + (b == c ? 0 : y.cost) + x->len;
+                glyph_opt_const(g, x, v, a, r, cost);
+                changed |= x->rewritten || x->kind == GLYPH_I_IMM;
+                break;
+            }
+            /* x+0, x-0, x|0, x^0, x<<0, x>>0, x*1, x/1 */
+            if (y.kind == 1 && y.val == (uint32_t)(op == '*' || op == '/') &&
+                op != '&' && op != '%') {
+                if (a == b) { x->dead = changed = 1; break; }
+                glyph_put4(seq, ':', '.', a, b);
+                glyph_rewrite(x, seq, 4);
+                changed = 1;
+                v[a] = v[b];
+                break;
+            }
+            /* A byte computed in this block: the backward pass may use it */
+            if (!imm && y.kind == 1 && y.cost && y.val < 256 && c != a && c != b &&
+                strchr("+-&<>", op))
+                x->imm = 1 + y.val;
+            v[a] = glyph_unknown;
+            break;
+        }
+        case '~':
+            v[a] = v[b].kind == 1 ? (GlyphVal){ 1, ~v[b].val, NULL, v[b].cost + 3 }
+                                  : glyph_unknown;
+            break;
+        case ':': {
+            GlyphVal nv = d.mode == '.' ? v[b] : (GlyphVal){ 1, d.val, NULL, 4 };
+            if ((d.mode == '.' && b == a) || glyph_same_val(v[a], nv)) {
+                x->dead = changed = 1;
+                break;
+            }
+            if (d.mode == '.' && nv.kind == 1 && nv.val < 256) {
+                glyph_put_byte(seq, a, nv.val);
+                glyph_rewrite(x, seq, 4);
+                changed = 1;
+                nv.cost = 4;
+            }
+            v[a] = nv;
+            break;
+        }
+        case '@': case '#':
+            if (glyph_rune_writes(&d)) v[a] = glyph_unknown;
+            break;
+        case '$':
+            if (d.mode == '?') v['?'] = glyph_unknown;
+            break;
+        case '?': {
+            GlyphVal nv = glyph_unknown;
+            if (a == b) {
+                nv = (GlyphVal){ 1, 1, NULL, 3 };
+            } else if (v[a].kind == 1 && v[b].kind == 1) {
+                uint32_t l = v[a].val, r = v[b].val;
+                nv = (GlyphVal){ 1, (l == r) | (l > r) << 1 | (l < r) << 2, NULL, 3 };
+            }
+            if (glyph_same_val(v['?'], nv)) {
+                x->dead = changed = 1;
+                break;
+            }
+            v['?'] = nv;
+            break;
+        }
+        case '.': {
+            if (d.mode != '.') {
+                if (v['?'].kind != 1) break;    /* May fall through */
+                if (!glyph_cond(d.mode, v['?'].val)) {
+                    x->dead = changed = 1;
+                    break;
+                }
+                seq[0] = '.'; seq[1] = '.'; seq[2] = a;
+                glyph_rewrite(x, seq, 3);
+                changed = 1;
+            }
+            /* A target loaded just before can skip straight to a jump's target */
+            int k = i;
+            while (--k >= 0 && (it[k].dead || glyph_item_code(g, &it[k])[0] == '?')) {}
+            if (k >= 0 && !x->start && it[k].kind == GLYPH_I_REF &&
+                g->refs[it[k].ref].reg == (char)a) {
+                GlyphLabelRef *r = &g->refs[it[k].ref];
+                const char *to = glyph_thread(g, it, n, r->name, r->reg);
+                if (to != r->name) { r->name = to; changed = 1; }
+            }
+            unreachable = 1;
+            break;
+        }
+        default:                                /* Calls, marks, skips */
+            glyph_opt_enter(g, v, x->pos);
+            break;
+        }
+    }
+    return changed;
+}
+
+/* Backward pass: drop writes to registers nothing reads */
+static inline int glyph_opt_backward(GlyphAsm *g, GlyphItem *it, int n) {
+    uint8_t live[128];
+    int changed = 0;
+    glyph_live_all(live);
+    for (int i = n - 1; i >= 0; i--) {
+        GlyphItem *x = &it[i];
+        if (x->dead) continue;
+        if (x->kind == GLYPH_I_DATA) {
+            glyph_live_all(live);
+        } else if (x->kind == GLYPH_I_REF || x->kind == GLYPH_I_IMM) {
+            char r = x->kind == GLYPH_I_REF ? g->refs[x->ref].reg : x->reg;
+            if (!live[r & 127]) x->dead = changed = 1;
+            live[r & 127] = 0;
+            if (x->kind == GLYPH_I_IMM && !x->dead && x->same) live[x->same & 127] = 1;
+        } else {
+            GlyphRune d;
+            glyph_read_rune(glyph_item_code(g, x), x->len, &d);
+            uint8_t a = d.a, b = d.b, c = d.c, w = glyph_rune_writes(&d);
+            if (d.len != x->len || !d.args) d.rune = ',';  /* Unknown: all live */
+            switch (d.rune) {
+            case '+': case '-': case '*': case '/': case '%':
+            case '&': case '|': case '^': case '<': case '>':
+            case '!': case '=': case '~': case ':': case '@': case '?': case '$':
+                if (w && w != '.' && !live[w]) { x->dead = changed = 1; break; }
+                if (w) live[w] = 0;
+                if (d.rune == '@' && !w) live[a] = 1;
+                if (d.rune == '?' || d.rune == '$') live[a] = 1;
+                if (d.rune != ':' || d.mode == '.') live[b] = 1;
+                if (x->imm && !live[c]) {     /* c's last read */
+                    uint8_t seq[5];
+                    glyph_put_opi(seq, d.rune, a, b, x->imm - 1);
+                    glyph_rewrite(x, seq, 5);
+                    x->imm = 0;
+                    changed = 1;
+                } else if (strlen(d.args) == 3 && d.args[2] == 'r') {
+                    live[c] = 1;
+                }
+                break;
+            case '#':
+                if (w) live[w] = 0;
+                else live[a] = 1;
+                live[b] = 1;
+                break;
+            case '.':
+                glyph_live_all(live);
+                live[a] = 1;
+                if (d.mode != '.') live['?'] = 1;
+                break;
+            case '[':
+                glyph_live_all(live);
+                live['?'] = 1;
+                break;
+            default:
+                glyph_live_all(live);
+                break;
+            }
+        }
+        if (x->start) {                 /* keep what x itself reads */
+            uint8_t t = live['~'], u = live['_'], q = live['?'];
+            glyph_live_all(live);
+            live['~'] = t; live['_'] = u; live['?'] = q;
+        }
+    }
+    return changed;
+}
+
+/* Optimize the code emitted so far. Returns -1 when out of memory or the
+ * result does not fit a fixed buffer, leaving the code as it was. */
+static inline int glyph_optimize(GlyphAsm *g, GlyphOptStats *stats) {
+    if (g->oom || g->dropped) return -1;
+    int n = 0, cap = 0, ri = 0, di = 0, li = 0;
+    GlyphItem *it = NULL;
+    for (uint32_t pos = 0; pos < g->pos;) {
+        if (n == cap) {
+            cap = cap ? cap * 2 : 1024;
+            GlyphItem *m = realloc(it, cap * sizeof(GlyphItem));
+            if (!m) { free(it); return -1; }
+            it = m;
+        }
+        GlyphItem *x = &it[n];
+        memset(x, 0, sizeof(*x));
+        x->pos = pos;
+        x->ref = -1;
+        while (ri < g->ref_count && g->refs[ri].addr < pos) ri++;
+        while (di < g->data_count && g->data[di].end <= pos) di++;
+        while (li < g->label_count && g->labels[li].addr < pos) li++;
+        /* A rune may not run into a label, a label load or data */
+        uint32_t stop = g->pos;
+        for (int l = li; l < g->label_count; l++)
+            if (g->labels[l].addr > pos) {
+                if (g->labels[l].addr < stop) stop = g->labels[l].addr;
+                break;
+            }
+        if (ri < g->ref_count && g->refs[ri].addr < stop) stop = g->refs[ri].addr;
+        if (di < g->data_count && g->data[di].start < stop) stop = g->data[di].start;
+        if (di < g->data_count && g->data[di].start <= pos) {
+            x->kind = GLYPH_I_DATA;
+            x->len = g->data[di].end - pos;
+            x->start = 1;
+        } else if (ri < g->ref_count && g->refs[ri].addr == pos && g->refs[ri].reg) {
+            x->kind = GLYPH_I_REF;
+            x->ref = ri;
+            x->len = g->refs[ri].max;
+        } else {
+            GlyphRune d;
+            glyph_read_rune(g->buf + pos, stop - pos, &d);
+            x->len = d.len ? d.len : 1;
+            if (glyph_lands(d.rune)) x->start = 1;
+        }
+        if ((li < g->label_count && g->labels[li].addr == pos) ||
+            (n && it[n - 1].kind == GLYPH_I_DATA) ||
+            (n && it[n - 1].kind == GLYPH_I_CODE && glyph_lands(g->buf[it[n - 1].pos])))
+            x->start = 1;
+        pos += x->len;
+        n++;
+    }
+    
+    GlyphOptStats st = { g->pos, 0, 0, 0 };
+    for (int i = 0; i < n; i++) st.insns_before += glyph_item_insns(&it[i]);
+    for (int pass = 0; pass < 8; pass++) {
+        int changed = glyph_opt_forward(g, it, n);
+        changed |= glyph_opt_backward(g, it, n);
+        if (!changed) break;
+    }
+    
+    /* Lay the surviving code out in a new buffer */
+    uint32_t out = 0;
+    for (int i = 0; i < n; i++) {
+        it[i].to = out;
+        if (!it[i].dead) {
+            out += it[i].len;
+            st.insns_after += glyph_item_insns(&it[i]);
+        }
+    }
+    uint8_t *buf = malloc(out ? out : 1);
+    if (!buf || (!g->owned && out > g->size)) {
+        free(buf);
+        free(it);
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        GlyphItem *x = &it[i];
+        if (x->dead) continue;
+        if (x->kind == GLYPH_I_IMM)
+            glyph_imm(buf + x->to, x->reg, x->val, x->same);
+        else
+            memcpy(buf + x->to, glyph_item_code(g, x), x->len);
+    }
+    
+    /* Move everything that points into the code */
+    #define GLYPH_MOVE(addr) do { \
+        int lo_ = 0, hi_ = n; \
+        while (lo_ < hi_) { \
+            int mid_ = (lo_ + hi_) / 2; \
+            if (it[mid_].pos < (addr)) lo_ = mid_ + 1; else hi_ = mid_; \
+        } \
+        if (lo_ > 0 && it[lo_ - 1].kind == GLYPH_I_DATA && \
+            it[lo_ - 1].pos + it[lo_ - 1].len > (addr)) \
+            lo_--; \
+        (addr) = lo_ < n ? it[lo_].to + ((addr) - it[lo_].pos) : out; \
+    } while (0)
+    for (int i = 0; i < g->label_count; i++) GLYPH_MOVE(g->labels[i].addr);
+    for (int i = 0; i < g->data_count; i++) {
+        uint32_t len = g->data[i].end - g->data[i].start;
+        GLYPH_MOVE(g->data[i].start);
+        g->data[i].end = g->data[i].start + len;
+    }
+    for (int r = 0; r < 128; r++)
+        if (g->const_known[r]) GLYPH_MOVE(g->const_pos[r]);
+    int kept = 0;
+    for (int i = 0, k = 0; i < g->ref_count; i++) {
+        while (k + 1 < n && it[k + 1].pos <= g->refs[i].addr) k++;
+        if (it[k].dead) continue;
+        g->refs[i].addr = it[k].to + (g->refs[i].addr - it[k].pos);
+        g->refs[kept++] = g->refs[i];
+    }
+    #undef GLYPH_MOVE
+    g->ref_count = kept;
+    
+    if (g->owned) {
+        free(g->buf);
+        g->buf = buf;
+        g->size = out ? out : 1;
+    } else {
+        memcpy(g->buf, buf, out);
+        free(buf);
+    }
+    g->pos = out;
+    st.bytes_after = out;
+    if (stats) *stats = st;
+    free(it);
     return 0;
 }
 